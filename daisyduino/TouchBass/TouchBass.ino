@@ -1,12 +1,36 @@
 // SYNTHUX ACADEMY /////////////////////////////////////////
 // TOUCH BASS //////////////////////////////////////////////
 
+// Uncomment to count heap allocations and
+// blocking calls made in the audio callback.
+// #define RT_GUARD
+
 #include "simple-daisy-touch.h"
+#include "rtguard.h"
 #include "aknob.h"
 #include "onoffon.h"
 #include "mvalue.h"
 #include "bass.h"
 
+// Uncomment to play the gesture script from script.h
+// instead of reading the pads, knobs and switches.
+// CPU load is reported over Serial when the script ends.
+// #define GESTURE_REPLAY
+
+// Uncomment to print the session over Serial
+// as gesture script lines for script.h.
+// #define GESTURE_RECORD
+
+#ifdef GESTURE_REPLAY
+#include "gesture.h"
+#include "load.h"
+#include "script.h"
+#endif
+
+#ifdef GESTURE_RECORD
+#include "gesture.h"
+#endif
+
 using namespace synthux;
 using namespace simpletouch;
 
@@ -55,11 +79,44 @@ static MValue verb_value;
 static const int clk_pin = D(S31);
 #endif
 
+// Uncomment to send MIDI clock, start and stop on
+// Serial1 (31250 baud), so other gear can follow.
+// #define MIDI_CLOCK_OUT
+
+#ifdef MIDI_CLOCK_OUT
+// How often the due MIDI bytes are sent, Hz.
+static const uint32_t kMidiFlushRate = 10000;
+#endif
+
 ////////////////////////////////////////////////////////////
 //////////////////////// MODULES //////////////////////////
 
 static Touch touch;
 static Bass bass;
+#ifdef EXTERNAL_SYNC
+static ClockIn<> clock_in;
+#endif
+#ifdef MIDI_CLOCK_OUT
+static Bass::MidiOut midi_clock;
+static HardwareTimer midi_timer(TIM5);
+#endif
+
+#ifdef GESTURE_REPLAY
+static GesturePlayer<> replay;
+static CpuLoad load;
+
+uint16_t ReadScriptKnob(uint8_t pin) {
+  return replay.Knob(pin - A(S30));
+}
+#endif
+
+#ifdef GESTURE_RECORD
+static GestureRecorder<> recorder;
+
+uint16_t RecordKnob(uint8_t pin) {
+  return recorder.Knob(pin - A(S30), analogRead(pin));
+}
+#endif
 
 ////////////////////////////////////////////////////////////
 ////////////////////////// STATE ///////////////////////////
@@ -95,10 +152,45 @@ void OnPadRelease(uint16_t pad) {
   bass.NoteOff(pad - kFirstNotePad);
 }
 
+///////////////////////////////////////////////////////////////
+////////////////////// CLOCK CALLBACKS ////////////////////////
+#ifdef EXTERNAL_SYNC
+// Pin interrupt, keep it short.
+void OnClockEdge() {
+  clock_in.Capture();
+}
+#endif
+
+#ifdef MIDI_CLOCK_OUT
+// Timer interrupt
+void OnMidiTimer() {
+  midi_clock.Flush(Serial1);
+}
+#endif
+
 ///////////////////////////////////////////////////////////////
 ///////////////////// AUDIO CALLBACK //////////////////////////
 void AudioCallback(float **in, float **out, size_t size) {
+  RTGuard::Scope rt_guard;
+  #ifdef GESTURE_REPLAY
+  load.Begin();
+  #endif
+
+  #ifdef EXTERNAL_SYNC
+  uint32_t edge;
+  while (clock_in.Pop(edge)) bass.SyncClockIn(edge, micros());
+  #endif
+
   bass.Process(out, size);
+
+  #ifdef GESTURE_REPLAY
+  replay.Advance(size);
+  load.End();
+  #endif
+
+  #ifdef GESTURE_RECORD
+  recorder.Advance(size);
+  #endif
 }
 
 ///////////////////////////////////////////////////////////////
@@ -111,6 +203,15 @@ void setup() {
 
   bass.Init(sample_rate, buffer_size);
 
+  #ifdef MIDI_CLOCK_OUT
+  Serial1.begin(31250);
+  midi_clock.Init(sample_rate, buffer_size);
+  bass.SetMidiOut(&midi_clock);
+  midi_timer.setOverflow(kMidiFlushRate, HERTZ_FORMAT);
+  midi_timer.attachInterrupt(OnMidiTimer);
+  midi_timer.resume();
+  #endif
+
   touch.Init();
   touch.SetOnTouch(OnPadTouch);
   touch.SetOnRelease(OnPadRelease);
@@ -120,8 +221,19 @@ void setup() {
 
   pinMode(LED_BUILTIN, OUTPUT);
 
+  #ifdef GESTURE_REPLAY
+  replay.Init(kScript, kScriptLength, sample_rate);
+  load.Init(sample_rate, buffer_size);
+  AKnob<>::SetSource(ReadScriptKnob);
+  #endif
+
+  #ifdef GESTURE_RECORD
+  recorder.Init(sample_rate);
+  AKnob<>::SetSource(RecordKnob);
+  #endif
+
   #ifdef EXTERNAL_SYNC
-  pinMode(clk_pin, INPUT);
+  clock_in.Init(clk_pin, OnClockEdge);
   #endif
 
   DAISY.begin(AudioCallback);
@@ -132,16 +244,27 @@ void setup() {
 Bass::VoxParams v_params;
 Bass::FilterParams f_params;
 void loop() {
-  #ifdef EXTERNAL_SYNC
-  bass.ProcessClockIn(!digitalRead(clk_pin));
+  #ifdef GESTURE_REPLAY
+  if (replay.Process()) load.Report();
+  touch.Process(replay.Pads());
+  #else
+  touch.Process();
   #endif
 
-  touch.Process();
+  #ifdef GESTURE_RECORD
+  recorder.Pads(touch.State());
+  recorder.Switch(0, arp_mode_switch.Value());
+  recorder.Switch(1, osc2_mode_switch.Value());
+  #endif
 
   is_to_touched = touch.IsTouched(10);
   is_ch_touched = touch.IsTouched(11);
 
+  #ifdef GESTURE_REPLAY
+  auto arp_mode_value = replay.Switch(0);
+  #else
   auto arp_mode_value = arp_mode_switch.Value();
+  #endif
   bass.SetArpOn(arp_mode_value > 0);
   bass.SetLatch(arp_mode_value > 1);
 
@@ -154,13 +277,25 @@ void loop() {
   v_params.osc1_pitch = osc_1_freq.Value();
   v_params.osc1_shape = osc_1_shape.Value();
   v_params.osc2_pitch = osc2_mult_knob.Process();
-  v_params.osc2_mode_index = osc2_mode_switch.Value(); 
+  #ifdef GESTURE_REPLAY
+  uint8_t osc2_mode_index = replay.Switch(1);
+  #else
+  uint8_t osc2_mode_index = osc2_mode_switch.Value(); 
+  #endif
+  auto is_osc2_mode_changed = osc2_mode_index != v_params.osc2_mode_index;
+  v_params.osc2_mode_index = osc2_mode_index;
   v_params.osc2_amnt = fmap(osc2_amount.Process(), 0.f, 1.f, Mapping::EXP);
   v_params.env = env_fader.Process();
-  bass.SetVoxParams(v_params);
+  // Bitwise or, so every change flag gets cleared
+  if (osc_1_freq.HasChanged() | osc_1_shape.HasChanged() | osc2_mult_knob.HasChanged()
+    | osc2_amount.HasChanged() | env_fader.HasChanged() | is_osc2_mode_changed) {
+    bass.SetVoxParams(v_params);
+  }
 
-  bass.SetPattern(pattern_knob.Process());
-  bass.SetHumanNoteChance(human_notes_knob.Process());
+  auto pattern = pattern_knob.Process();
+  if (pattern_knob.HasChanged()) bass.SetPattern(pattern);
+  auto human_notes = human_notes_knob.Process();
+  if (human_notes_knob.HasChanged()) bass.SetHumanNoteChance(human_notes);
 
   auto flt_value = fmap(filter_fader.Process(), 0.f, 1.f, Mapping::EXP);
   flt_freq.SetActive(!is_to_touched && !is_ch_touched, flt_value);
@@ -183,16 +318,26 @@ void loop() {
     flt_freq.Process(flt_value);
   }
 
-  f_params.freq = flt_freq.Value();
-  f_params.reso = flt_reso.Value();
-  f_params.env_amount = flt_env_amount.Value();
-  bass.SetFilterParams(f_params);
+  if (flt_freq.HasChanged() | flt_reso.HasChanged() | flt_env_amount.HasChanged()) {
+    f_params.freq = flt_freq.Value();
+    f_params.reso = flt_reso.Value();
+    f_params.env_amount = flt_env_amount.Value();
+    bass.SetFilterParams(f_params);
+  }
 
-  bass.SetHumanEnvelopeChance(human_env_value.Value());
+  if (human_env_value.HasChanged()) bass.SetHumanEnvelopeChance(human_env_value.Value());
   
-  bass.SetReverbMix(verb_value.Value());  
+  if (verb_value.HasChanged()) bass.SetReverbMix(verb_value.Value());  
 
   digitalWrite(LED_BUILTIN, bass.IsLatched());
+  bass.Recover();
+
+  #ifdef GESTURE_RECORD
+  recorder.Flush();
+  #endif
+
+  bass.ReportSentinels();
+  RTGuard::Report();
 
   delay(4);
 }
@@ -13,6 +13,8 @@ class AKnob {
           bool  flip = false,
           bool  invert = false):
           val_    { 0.0f },
+          out_    { 0.0f },
+          changed_ { true },
           pin_    { pin },
           coeff_  { coeff },
           quant_  { quant },
@@ -24,20 +26,45 @@ class AKnob {
     pinMode(pin_, INPUT);
   }
 
+    // Replaces analogRead as the source of raw values
+    // for all knobs, e.g. with a gesture player.
+    static void SetSource(uint16_t(*source)(uint8_t pin)) {
+      source_ = source;
+    }
+
     float Process() {
-      float t = static_cast<float>(analogRead(pin_)) * kFrac;
+      float t = static_cast<float>(_read_raw()) * kFrac;
       if (flip_) t = 1.f - t;
       if (invert_) t = -t;
       val_ += coeff_ * (t - val_);
-      return round(val_ * quant_) / quant_;
+      auto out = round(val_ * quant_) / quant_;
+      if (out != out_) changed_ = true;
+      out_ = out;
+      return out;
+    }
+
+    // True if the quantized value moved since the last call.
+    // Starts out true so the first reading gets applied.
+    bool HasChanged() {
+      auto changed = changed_;
+      changed_ = false;
+      return changed;
     }
 
   private:
     static constexpr float kFrac = 1.f / (powf(2.f, bits) - 1.f);
 
+    uint16_t _read_raw() {
+      return source_ != nullptr ? source_(pin_) : analogRead(pin_);
+    }
+
+    static inline uint16_t(*source_)(uint8_t pin) = nullptr;
+
     uint8_t pin_;
     float coeff_; 
     float val_;
+    float out_;
+    bool  changed_;
     float quant_;
     bool  flip_;
     bool  invert_;
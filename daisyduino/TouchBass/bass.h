@@ -16,6 +16,7 @@
 #include "vox.h"
 #include "flt.h"
 #include "xfade.h"
+#include "sentinel.h"
 
 namespace synthux {
 
@@ -36,8 +37,16 @@ public:
     float env_amount;
   };
 
+  static constexpr uint8_t kPPQN = 24;
+  using MidiOut = MidiClockOut<kPPQN>;
+
   Bass():
+  _voice_sentinel     { _sentinels, "voice" },
+  _filter_sentinel    { _sentinels, "filter" },
+  _reverb_sentinel    { _sentinels, "reverb" },
+  _master_sentinel    { _sentinels, "master" },
   _dice               { std::uniform_int_distribution<uint8_t>(0, 100) },
+  _vox_params         { },
   _tempo              { .45f },
   _env                { 0.f },
   _human_env_kof      { 0.f },
@@ -58,6 +67,8 @@ public:
   void Init(const float sample_rate, const float buffer_size) {
     using namespace std::placeholders;
 
+    _sample_rate = sample_rate;
+
     _clock.Init(sample_rate, buffer_size);
 
     auto on_clock = std::bind(&Bass::_on_clock_tick, this);
@@ -82,9 +93,7 @@ public:
 
     _filter.Init(sample_rate);
 
-    _reverb.Init(sample_rate);
-    _reverb.SetFeedback(0.8);
-    _reverb.SetLpFreq(10000.f);
+    _init_reverb();
   }
 
   void SetTempo(const float tempo) { 
@@ -105,6 +114,15 @@ public:
     _clock.Process(state); 
   }
 
+  // Edge timestamp from ClockIn, call before Process().
+  void SyncClockIn(const uint32_t edge_us, const uint32_t now_us) {
+    _clock.Sync(edge_us, now_us);
+  }
+
+  void SetMidiOut(MidiOut* midi_out) {
+    _clock.SetMidiOut(midi_out);
+  }
+
   void SetArpOn(const bool value) {
     if (value != _is_arp_on) Reset();
     _is_arp_on = value;
@@ -138,12 +156,14 @@ public:
   void NextScale() {
     _scale_index = std::min(static_cast<uint8_t>(_scale.ScalesCount() - 1), ++_scale_index);
     _scale.SetScaleIndex(_scale_index);
+    SetVoxParams(_vox_params);
   }
 
   void PrevScale() {
     if (_scale_index == 0) return;
     _scale_index--;
     _scale.SetScaleIndex(_scale_index);
+    SetVoxParams(_vox_params);
   }
 
   void NoteOn(const uint8_t note) {
@@ -209,7 +229,9 @@ public:
     _human_env_kof = _human_env_chance * 0.0001f;
   }
 
+  // Writes every voice, call on change only.
   void SetVoxParams(const VoxParams& p) {
+    _vox_params = p;
     auto osc1_mult = _scale.TransMult(p.osc1_pitch);
     
     auto osc2_mult = 1.f;
@@ -249,21 +271,70 @@ public:
 
   void Process(float **out, size_t size) {
     _clock.Tick();
+    auto is_reverb_on = !_reverb_reset.IsPending();
     float output;
     for (size_t i = 0; i < size; i++) {
       output = 0;
       for (auto k = 0; k < kVoxCount; k++) {
         output += _voices[k].Process() * .5f;
       }
-      _bus[0] = _bus[1] = _filter.Process(output);
-      _xfade.Process(0, 0, _bus[0], _bus[1], _reverb_in[0], _reverb_in[1]);
-      _reverb.Process(_reverb_in[0], _reverb_in[1], &(_reverb_out[0]), &(_reverb_out[1]));
-      out[0][i] = (_bus[0] + _reverb_out[0]) * .75f;
-      out[1][i] = (_bus[1] + _reverb_out[1]) * .75f;
+      _voice_sentinel.Watch(output);
+      _bus[0] = _bus[1] = _filter_sentinel.Watch(_filter.Process(output));
+      if (is_reverb_on) {
+        _xfade.Process(0, 0, _bus[0], _bus[1], _reverb_in[0], _reverb_in[1]);
+        _reverb.Process(_reverb_in[0], _reverb_in[1], &(_reverb_out[0]), &(_reverb_out[1]));
+        _reverb_sentinel.Watch(_reverb_out[0]);
+        _reverb_sentinel.Watch(_reverb_out[1]);
+      }
+      out[0][i] = _master_sentinel.Watch((_bus[0] + _reverb_out[0]) * .75f);
+      out[1][i] = _master_sentinel.Watch((_bus[1] + _reverb_out[1]) * .75f);
     }
+    _check_sentinels(out, size);
+  }
+
+  // Call from loop(). Finishes the resets
+  // too heavy for the audio callback.
+  void Recover() {
+    _reverb_reset.Run([this] { _init_reverb(); });
+  }
+
+  // Call from loop(). Prints the sentinels that tripped.
+  void ReportSentinels() {
+    _sentinels.Report();
   }
 
 private:
+  void _init_reverb() {
+    _reverb.Init(_sample_rate);
+    _reverb.SetFeedback(0.8);
+    _reverb.SetLpFreq(10000.f);
+  }
+
+  // Silent until Recover() has run the reset.
+  void _mute_reverb() {
+    _reverb_out[0] = _reverb_out[1] = 0.f;
+    _reverb_reset.Request();
+  }
+
+  // Resets whatever blew up in the last block.
+  // A master trip resets everything and mutes the block.
+  void _check_sentinels(float **out, size_t size) {
+    auto is_voice_bad = _voice_sentinel.Check();
+    auto is_filter_bad = _filter_sentinel.Check();
+    auto is_reverb_bad = _reverb_sentinel.Check();
+    auto is_master_bad = _master_sentinel.Check();
+    if (is_voice_bad || is_master_bad) {
+      for (auto& v: _voices) v.Reset();
+    }
+    if (is_filter_bad || is_master_bad) _filter.Reset();
+    if (is_reverb_bad || is_master_bad) _mute_reverb();
+    if (is_master_bad) {
+      for (size_t i = 0; i < size; i++) {
+        out[0][i] = out[1][i] = 0.f;
+      }
+    }
+  }
+
   void _on_clock_tick() { 
     if (_trigger.Tick() && _pattern.Tick()) {
       _arp.Trigger();
@@ -310,7 +381,6 @@ private:
     }
   }
 
-  static constexpr uint8_t kPPQN = 24;
   static constexpr uint8_t kNotesCount = 7;
   static constexpr uint8_t kVoxCount = 4;
 
@@ -325,13 +395,23 @@ private:
   ReverbSc                    _reverb;
   XFade                       _xfade;
 
+  Sentinel::Registry          _sentinels;
+  Sentinel                    _voice_sentinel;
+  Sentinel                    _filter_sentinel;
+  Sentinel                    _reverb_sentinel;
+  Sentinel                    _master_sentinel;
+  DeferredReset               _reverb_reset;
+
   std::default_random_engine _rand_engine;
   std::uniform_int_distribution<uint8_t> _dice;
 
+  VoxParams _vox_params;
+
   std::array<float, 2> _reverb_in;
   std::array<float, 2> _reverb_out;
   std::array<float, 2> _bus;
   
+  float   _sample_rate;
   float   _tempo;
   float   _env;
   float   _human_env_kof;
@@ -13,10 +13,20 @@ public:
   ~Filter() {}
 
   void Init(const float sample_rate) {
+    _sample_rate = sample_rate;
+    _reso = 0.2f;
     _env.Init(sample_rate);
     _flt.Init(sample_rate);
     _flt.SetFreq(10000.f);
-    _flt.SetRes(0.2f);
+    _flt.SetRes(_reso);
+  }
+
+  // Clears the filter state, e.g. after it blew up.
+  // Keeps the current settings.
+  void Reset() {
+    _flt.Init(_sample_rate);
+    _flt.SetFreq(_freq);
+    _flt.SetRes(_reso);
   }
 
   void Trigger(bool retrigger = false) {
@@ -51,7 +61,8 @@ public:
   }
 
   void SetReso(const float value) {
-    _flt.SetRes(fmap(value, 0.f, .9f));
+    _reso = fmap(value, 0.f, .9f);
+    _flt.SetRes(_reso);
   }
 
   float Process(const float in) {
@@ -74,7 +85,9 @@ private:
 
   Svf _flt;
   Envelope _env;
+  float _sample_rate;
   float _freq;
+  float _reso;
   float _freq_env_room;
   float _env_amount;
   bool _pending_retrigger;
@@ -0,0 +1,118 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "Arduino.h"
+
+namespace synthux {
+
+/**
+ * @brief
+ * 24 PPQN MIDI clock, start and stop out of a Clock tick stream.
+ * The clock calls Tick() from the audio callback with the sample
+ * offset of each tick in the block. Every ppqn / 24 ticks a clock
+ * byte is queued with the time it's due: one block after the
+ * callback, when that block actually plays, plus the offset.
+ * Flush() sends the bytes that are due; call it from a fast timer
+ * interrupt so their timing doesn't depend on loop().
+ *
+ * The queue is lock-free with one producer (Tick) and one
+ * consumer (Flush), each publishing its index with release.
+ * Start() and Stop() only raise flags, so they can be called
+ * from anywhere.
+ */
+template<size_t ppqn, size_t capacity = 16>
+class MidiClockOut {
+public:
+  static constexpr uint8_t kClock = 0xf8;
+  static constexpr uint8_t kStart = 0xfa;
+  static constexpr uint8_t kStop = 0xfc;
+
+  MidiClockOut():
+  _us_per_sample  { 0.f },
+  _latency_us     { 0 },
+  _count          { 0 },
+  _head           { 0 },
+  _tail           { 0 },
+  _start_pending  { false },
+  _stop_pending   { false }
+  {}
+
+  void Init(const float sample_rate, const float buffer_size) {
+    _us_per_sample = 1e6f / sample_rate;
+    _latency_us = static_cast<uint32_t>(buffer_size * _us_per_sample);
+  }
+
+  // Start goes out right before the next clock.
+  void Start() {
+    _start_pending.store(true, std::memory_order_release);
+  }
+
+  // Stop goes out with the next Flush(), dropping queued clocks.
+  void Stop() {
+    _stop_pending.store(true, std::memory_order_release);
+  }
+
+  // Audio callback, offset - sample of the tick in the block.
+  void Tick(const uint32_t offset) {
+    auto due = micros() + _latency_us + static_cast<uint32_t>(offset * _us_per_sample);
+    if (_start_pending.exchange(false, std::memory_order_acq_rel)) {
+      _count = 0;
+      _push(kStart, due);
+    }
+    if (_count == 0) _push(kClock, due);
+    if (++_count == kDivider) _count = 0;
+  }
+
+  template<typename Port>
+  void Flush(Port& port) {
+    auto head = _head.load(std::memory_order_acquire);
+    if (_stop_pending.exchange(false, std::memory_order_acq_rel)) {
+      _tail.store(head, std::memory_order_release);
+      port.write(kStop);
+      return;
+    }
+    auto now = micros();
+    auto tail = _tail.load(std::memory_order_relaxed);
+    while (tail != head) {
+      auto& e = _queue[tail];
+      if (static_cast<int32_t>(now - e.due) < 0) break;
+      if (port.availableForWrite() < 1) break;
+      port.write(e.byte);
+      tail = (tail + 1) & kMask;
+    }
+    _tail.store(tail, std::memory_order_release);
+  }
+
+private:
+  static_assert(ppqn % 24 == 0, "ppqn must be a multiple of 24");
+  static_assert((capacity & (capacity - 1)) == 0, "Capacity must be a power of 2");
+  static constexpr size_t kDivider = ppqn / 24;
+  static constexpr size_t kMask = capacity - 1;
+
+  struct Event {
+    uint32_t due;
+    uint8_t byte;
+  };
+
+  // Drops the byte if the queue is full.
+  void _push(const uint8_t byte, const uint32_t due) {
+    auto head = _head.load(std::memory_order_relaxed);
+    auto next = (head + 1) & kMask;
+    if (next == _tail.load(std::memory_order_acquire)) return;
+    _queue[head] = { due, byte };
+    _head.store(next, std::memory_order_release);
+  }
+
+  Event _queue[capacity];
+  float _us_per_sample;
+  uint32_t _latency_us;
+  size_t _count;
+  std::atomic<size_t> _head;
+  std::atomic<size_t> _tail;
+  std::atomic<bool> _start_pending;
+  std::atomic<bool> _stop_pending;
+};
+
+};
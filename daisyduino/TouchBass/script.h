@@ -0,0 +1,55 @@
+#pragma once
+#include "gesture.h"
+
+namespace synthux {
+
+// Bass, 4-voice arp at 240 BPM.
+// Switch 0 - arp mode (S07/S08), switch 1 - osc 2 mode (S09/S10).
+// Knob N is S30 + N, see the layout in TouchBass.ino.
+// Times in ms.
+
+static const Gesture kScript[] = {
+  // Initial controls
+  { 0, Gesture::kKnob, 0, 300 },  // osc 2 amount
+  { 0, Gesture::kKnob, 1, 512 },  // osc 1 pitch
+  { 0, Gesture::kKnob, 2, 512 },  // osc 2 pitch
+  { 0, Gesture::kKnob, 3, 1023 }, // pattern, all onsets
+  { 0, Gesture::kKnob, 4, 0 },    // note randomisation
+  { 0, Gesture::kKnob, 5, 0 },    // envelope randomisation
+  { 0, Gesture::kKnob, 6, 700 },  // filter
+  { 0, Gesture::kKnob, 7, 300 },  // envelope
+  { 0, Gesture::kSwitch, 0, 1 },  // arp on
+  { 0, Gesture::kSwitch, 1, 0 },  // osc 2 sound
+
+  // Hold P10 and tap P02 11 times: tempo .45 -> 1.0, i.e. 240 BPM
+  { 100, Gesture::kPad, 10, 1 },
+  { 150, Gesture::kPad, 2, 1 }, { 170, Gesture::kPad, 2, 0 },
+  { 190, Gesture::kPad, 2, 1 }, { 210, Gesture::kPad, 2, 0 },
+  { 230, Gesture::kPad, 2, 1 }, { 250, Gesture::kPad, 2, 0 },
+  { 270, Gesture::kPad, 2, 1 }, { 290, Gesture::kPad, 2, 0 },
+  { 310, Gesture::kPad, 2, 1 }, { 330, Gesture::kPad, 2, 0 },
+  { 350, Gesture::kPad, 2, 1 }, { 370, Gesture::kPad, 2, 0 },
+  { 390, Gesture::kPad, 2, 1 }, { 410, Gesture::kPad, 2, 0 },
+  { 430, Gesture::kPad, 2, 1 }, { 450, Gesture::kPad, 2, 0 },
+  { 470, Gesture::kPad, 2, 1 }, { 490, Gesture::kPad, 2, 0 },
+  { 510, Gesture::kPad, 2, 1 }, { 530, Gesture::kPad, 2, 0 },
+  { 550, Gesture::kPad, 2, 1 }, { 570, Gesture::kPad, 2, 0 },
+  { 600, Gesture::kPad, 10, 0 },
+
+  // Four notes for 20 seconds
+  { 1000, Gesture::kPad, 3, 1 },
+  { 1000, Gesture::kPad, 5, 1 },
+  { 1000, Gesture::kPad, 7, 1 },
+  { 1000, Gesture::kPad, 9, 1 },
+  { 21000, Gesture::kPad, 3, 0 },
+  { 21000, Gesture::kPad, 5, 0 },
+  { 21000, Gesture::kPad, 7, 0 },
+  { 21000, Gesture::kPad, 9, 0 },
+
+  // Let the tails ring out
+  { 22000, Gesture::kKnob, 0, 300 }
+};
+
+static constexpr size_t kScriptLength = sizeof(kScript) / sizeof(Gesture);
+
+};
@@ -0,0 +1,111 @@
+#pragma once
+#include <stdint.h>
+
+namespace synthux {
+
+struct Position {
+  uint32_t bar;
+  uint32_t beat;
+  uint32_t tick;
+  // 0...1 towards the next tick
+  float phase;
+  // Since the start
+  uint64_t sample;
+};
+
+/**
+ * @brief
+ * Converts samples to clock ticks as an exact fraction.
+ * The tempo is kept in thousandths of a BPM. Every sample adds
+ * tempo * ppqn to a 64 bit phase, and one tick is
+ * 60000 * sample_rate of it, so nothing is ever rounded: the tick
+ * grid stays locked to the sample clock however long it runs.
+ */
+template<uint32_t ppqn, uint32_t beats_per_bar = 4>
+class Transport {
+public:
+  Transport():
+  _sample_rate  { 48000 },
+  _tick_length  { kMilliPerMinute * 48000 },
+  _milli_bpm    { 120000 },
+  _phase        { 0 },
+  _sample       { 0 },
+  _last_size    { 0 }
+  {}
+
+  void Init(const uint32_t sample_rate) {
+    _sample_rate = sample_rate;
+    _tick_length = kMilliPerMinute * sample_rate;
+  }
+
+  void SetTempo(const float bpm) {
+    SetMilliBPM(static_cast<uint32_t>(bpm * 1000.f + .5f));
+  }
+
+  void SetMilliBPM(const uint32_t milli_bpm) {
+    if (milli_bpm > 0) _milli_bpm = milli_bpm;
+  }
+
+  // Quarter note length, us.
+  void SetBeatLength(const float us) {
+    if (us > 0.f) SetMilliBPM(static_cast<uint32_t>(6e10f / us + .5f));
+  }
+
+  uint32_t MilliBPM() const { return _milli_bpm; }
+
+  float Tempo() const { return _milli_bpm * .001f; }
+
+  // Moves size samples ahead, returns the ticks passed.
+  uint32_t Advance(const uint32_t size) {
+    _sample += size;
+    _last_size = size;
+    _phase += static_cast<uint64_t>(_milli_bpm) * ppqn * size;
+    if (_phase < _tick_length) return 0;
+    auto ticks = _phase / _tick_length;
+    _phase -= ticks * _tick_length;
+    return static_cast<uint32_t>(ticks);
+  }
+
+  // Sample of the last Advance() at which the index-th
+  // of the count ticks it returned fell.
+  uint32_t TickOffset(const uint32_t index, const uint32_t count) const {
+    auto past = _phase + static_cast<uint64_t>(count - 1 - index) * _tick_length;
+    auto since = past / (static_cast<uint64_t>(_milli_bpm) * ppqn);
+    return since >= _last_size ? 0 : _last_size - 1 - static_cast<uint32_t>(since);
+  }
+
+  // Puts a tick boundary since_us ago. Ticks due
+  // since then come out of the next Advance().
+  void Resync(const uint32_t since_us = 0) {
+    _phase = static_cast<uint64_t>(_milli_bpm) * ppqn * since_us * _sample_rate / 1000000;
+  }
+
+  void Reset() {
+    _phase = 0;
+    _sample = 0;
+  }
+
+  // Where the given tick count sits in bars and beats.
+  Position At(const uint64_t ticks) const {
+    auto beats = ticks / ppqn;
+    return {
+      static_cast<uint32_t>(beats / beats_per_bar),
+      static_cast<uint32_t>(beats % beats_per_bar),
+      static_cast<uint32_t>(ticks % ppqn),
+      static_cast<float>(_phase) / static_cast<float>(_tick_length),
+      _sample
+    };
+  }
+
+private:
+  static constexpr uint64_t kMilliPerMinute = 60000;
+
+  uint32_t _sample_rate;
+  uint64_t _tick_length;
+  uint32_t _milli_bpm;
+  uint64_t _phase;
+  uint64_t _sample;
+  uint32_t _last_size;
+};
+
+};
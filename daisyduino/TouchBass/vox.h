@@ -2,6 +2,7 @@
 
 #include "DaisyDSP.h"
 #include "env.h"
+#include "wavetable.h"
 
 namespace synthux {
 
@@ -23,9 +24,11 @@ Vox():
 void Init(float sample_rate) {
   _sample_rate = sample_rate;
   _osc1.Init(sample_rate);
-  _osc1.SetWaveform(Oscillator::WAVE_SAW);
+  _osc1.SetWaveform(Waveform::saw);
+  _osc1.SetAmp(.5f);
   _osc2.Init(sample_rate);
-  _osc2.SetWaveform(Oscillator::WAVE_TRI);
+  _osc2.SetWaveform(Waveform::tri);
+  _osc2.SetAmp(.5f);
   _env.Init(sample_rate);
 }
 
@@ -46,8 +49,8 @@ void SetOsc2Mode(const Osc2Mode mode) {
 } 
 
 void SetOsc1Shape(const float value) {
-  if (value < .5f) _osc1.SetWaveform(Oscillator::WAVE_POLYBLEP_SAW);
-  else _osc1.SetWaveform(Oscillator::WAVE_POLYBLEP_SQUARE);
+  if (value < .5f) _osc1.SetWaveform(Waveform::saw);
+  else _osc1.SetWaveform(Waveform::square);
 }
 
 void NoteOn(float freq, float amp, bool retrigger) {
@@ -65,6 +68,15 @@ void NoteOff() {
   _env.Release();
 }
 
+// Restarts the oscillators and fades the envelope out,
+// e.g. after the voice blew up.
+void Reset() {
+  _osc1.Reset();
+  _osc2.Reset();
+  _env.Reset();
+  _pending_freq = 0;
+}
+
 void SetEnvelope(const float value) {
   _env.SetShape(value);
 }
@@ -106,8 +118,8 @@ private:
   static constexpr float kSlopeMin  = 0.01f;
   static constexpr float kSlopeMax  = 1.99f;
 
-  Oscillator _osc1;
-  Oscillator _osc2;
+  WaveOsc _osc1;
+  WaveOsc _osc2;
   synthux::Envelope _env;
   float _sample_rate;
   float _base_freq;
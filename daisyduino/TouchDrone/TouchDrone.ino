@@ -1,14 +1,34 @@
+// Uncomment to count heap allocations and
+// blocking calls made in the audio callback.
+// #define RT_GUARD
+
+// Uncomment to time the filter tiers against
+// MoogLadder at startup and print the results
+// over Serial. Audio starts after it.
+// #define FILTER_BENCH
+
 #include "simple-daisy.h"
-#include "vox.h"
+#include "rtguard.h"
+#include "unison.h"
 #include "term.h"
 #include "driver.h"
 #include "aknob.h"
+#include "scanner.h"
+#include "scheduler.h"
 #include "memknob.h"
 #include "flt.h"
 #include "env.h"
 #include <array>
 
-static std::array<synthux::Vox, synthux::Driver::kVoices> vox;
+#ifdef FILTER_BENCH
+#include "bench.h"
+#endif
+
+// Detuned saws per chord voice. The oscillator cost
+// grows linearly with it.
+static const size_t kUnisonVoices = 4;
+static synthux::UnisonDrone<synthux::Driver::kVoices, kUnisonVoices> drone;
+static const float kMaxDetune = 40.f; // cents
 
 ////////////////////////////////////////////////////////////
 ///////////////////// KNOBS & SWITCHES /////////////////////
@@ -24,30 +44,44 @@ static std::array<synthux::Vox, synthux::Driver::kVoices> vox;
 
 static synthux::Terminal terminal;
 static synthux::AKnob freq_knob(A(S30));
+static synthux::AKnob detune_knob(A(S31));
 static synthux::AKnob spread_knob(A(S32));
 static synthux::AKnob glide_knob(A(S33));
 static synthux::AKnob envelope_knob(A(S36));
 static synthux::AKnob filter_knob(A(S37));
+// Knob pins are converted one at a time between control ticks,
+// the knobs read the latest value.
+static const uint8_t kKnobsCount = 6;
+static synthux::AdcScanner<synthux::ArduinoAdc, kKnobsCount> adc({
+  A(S30), A(S31), A(S32), A(S33), A(S36), A(S37)
+});
 static int quantize_switch = D(S07);
 static int scale_a_switch = D(S09);
 static int scale_b_switch = D(S10);
 
 static synthux::Driver drive;
-static synthux::Filter filter;
+// Saturation::none is cheapest, Saturation::tanh the most analog.
+static synthux::Filter<synthux::Saturation::poly> filter;
 static synthux::Envelope envelope;
 
 static const int kPadsCount = 7;
 static std::array<synthux::MemKnob, kPadsCount> mk_freq;
 static std::array<synthux::MemKnob, kPadsCount> mk_spread;
 
+static const uint32_t kControlPeriod = 4000; // us
+// Every knob is converted once per control tick.
+static const uint32_t kScanPeriod = kControlPeriod / kKnobsCount; // us
+static synthux::Scheduler<2> scheduler;
+
 bool gate = false;
 
 void AudioCallback(float **in, float **out, size_t size) {
+  synthux::RTGuard::Scope rt_guard;
+  if (envelope.IsRunning() || gate) drone.Process(out[0], size);
   for (size_t i = 0; i < size; i++) {
     float output = 0;
     if (envelope.IsRunning() || gate) {
-      for (auto& v: vox) output += v.Process(); 
-      output = filter.Process(output) * envelope.Process(gate) * 0.75;
+      output = filter.Process(out[0][i]) * envelope.Process(gate) * 0.75;
     }
     out[0][i] = out[1][i] = output;
   }
@@ -57,10 +91,14 @@ void setup() {
   DAISY.init(DAISY_SEED, AUDIO_SR_48K);
   auto sampleRate = DAISY.get_samplerate();
 
+  #ifdef FILTER_BENCH
+  synthux::FilterBench().Run(sampleRate);
+  #endif
+
   envelope.Init(sampleRate);
   terminal.Init();
   filter.Init(sampleRate);
-  for (auto& v: vox) v.Init(sampleRate);
+  drone.Init(sampleRate);
   for (auto i = 0; i < kPadsCount; i++) {
     mk_freq[i].Init(static_cast<float>(i) / kPadsCount);
   }
@@ -71,13 +109,22 @@ void setup() {
   pinMode(scale_a_switch, INPUT_PULLUP);
   pinMode(scale_b_switch, INPUT_PULLUP);
 
+  adc.Init();
+  scheduler.Add(kScanPeriod, [] { adc.Scan(); });
+  scheduler.Add(kControlPeriod, Control);
+  scheduler.Init();
+
   // BEGIN CALLBACK
   DAISY.begin(AudioCallback);
 }
 
 void loop() {
-  auto freq = freq_knob.Process();
-  auto spread = spread_knob.Process();
+  scheduler.Run();
+}
+
+void Control() {
+  auto freq = freq_knob.Process(adc);
+  auto spread = spread_knob.Process(adc);
   terminal.Process();  
   
   gate = false;
@@ -101,13 +148,15 @@ void loop() {
     }
   }
 
-  for (auto i = 0; i < vox.size(); i++) {
-    vox[i].SetPortamento(1 - glide_knob.Process());
-    vox[i].SetFreq(drive.FreqAt(i));
+  auto detune = detune_knob.Process(adc) * kMaxDetune;
+  drone.SetPortamento(1 - glide_knob.Process(adc));
+  for (size_t i = 0; i < synthux::Driver::kVoices; i++) {
+    drone.SetFreq(i, drive.FreqAt(i));
+    drone.SetDetune(i, detune);
   }
 
-  filter.SetTimbre(filter_knob.Process());
-  envelope.SetAmount(envelope_knob.Process());
+  filter.SetTimbre(filter_knob.Process(adc));
+  envelope.SetAmount(envelope_knob.Process(adc));
 
-  delay(4);
+  synthux::RTGuard::Report();
 }
@@ -26,7 +26,19 @@ class AKnob {
   }
 
     float Process() {
-      float t = static_cast<float>(analogRead(pin_)) * kFrac;
+      return ProcessRaw(static_cast<uint16_t>(analogRead(pin_)));
+    }
+
+    // Reads the pin's latest conversion from a scanner
+    // instead of converting on the spot.
+    template<typename Scanner>
+    float Process(const Scanner& scanner) {
+      return ProcessRaw(scanner.Read(pin_));
+    }
+
+    // Takes a conversion made elsewhere.
+    float ProcessRaw(const uint16_t raw) {
+      float t = static_cast<float>(raw) * kFrac;
       if (flip_) t = 1.f - t;
       if (invert_) t = -t;
       val_ += coeff_ * (t - val_);
@@ -0,0 +1,88 @@
+#pragma once
+#include <math.h>
+
+#include "DaisyDuino.h"
+#include "flt.h"
+
+namespace synthux {
+
+/**
+ * @brief
+ * Times the ladder tiers against daisysp::MoogLadder on a
+ * saw sweep and prints ns per sample over Serial.
+ * Call from setup() before DAISY.begin().
+ */
+class FilterBench {
+public:
+  void Run(const float sample_rate) {
+    Serial.println("BENCH: filter, ns/sample");
+
+    daisysp::MoogLadder moog;
+    moog.Init(sample_rate);
+    _print("MoogLadder", _time(
+      [&](const float timbre) {
+        moog.SetFreq(_map(timbre, 80.f, 16000.f));
+        moog.SetRes(1.f - _map(timbre, .3f, 1.f));
+      },
+      [&](const float in) { return moog.Process(in); }
+    ));
+
+    Filter<Saturation::none> none;
+    none.Init(sample_rate);
+    _print("ZDF none", _time(
+      [&](const float timbre) { none.SetTimbre(timbre); },
+      [&](const float in) { return none.Process(in); }
+    ));
+
+    Filter<Saturation::poly> poly;
+    poly.Init(sample_rate);
+    _print("ZDF poly", _time(
+      [&](const float timbre) { poly.SetTimbre(timbre); },
+      [&](const float in) { return poly.Process(in); }
+    ));
+
+    Filter<Saturation::tanh> exact;
+    exact.Init(sample_rate);
+    _print("ZDF tanh", _time(
+      [&](const float timbre) { exact.SetTimbre(timbre); },
+      [&](const float in) { return exact.Process(in); }
+    ));
+  }
+
+private:
+  static constexpr size_t kSamples = 48000;
+  // 4 ms at 48k
+  static constexpr size_t kControlPeriod = 192;
+
+  // Sets the timbre every control period, like loop() does.
+  template<typename S, typename P>
+  float _time(S&& set_timbre, P&& process) {
+    auto phase = 0.f;
+    auto sink = 0.f;
+    auto start = micros();
+    for (size_t i = 0; i < kSamples; i++) {
+      if (i % kControlPeriod == 0) set_timbre(static_cast<float>(i) / kSamples);
+      phase += .0025f;
+      if (phase >= 1.f) phase -= 1.f;
+      sink += process(2.f * phase - 1.f);
+    }
+    auto elapsed = micros() - start;
+    _sink = sink;
+    return 1000.f * elapsed / kSamples;
+  }
+
+  void _print(const char* name, const float ns) {
+    Serial.print("BENCH: ");
+    Serial.print(name);
+    Serial.print(", ");
+    Serial.println(ns);
+  }
+
+  float _map(float val, float min, float max) {
+    return (max - min) * val + min;
+  }
+
+  volatile float _sink;
+};
+
+};
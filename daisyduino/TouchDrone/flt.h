@@ -1,32 +1,108 @@
 #pragma once
+#include <math.h>
 
 #include "DaisyDuino.h"
 
 namespace synthux {
 
+// Saturation of the ladder input, cheapest first.
+enum class Saturation {
+  none, // Linear
+  poly, // Cubic soft clip
+  tanh  // tanhf
+};
+
+/**
+ * @brief
+ * Zero-delay-feedback (TPT) 4-pole ladder lowpass.
+ * The feedback loop is solved per sample, so cutoff and
+ * resonance stay accurate up to the top of the range without
+ * oversampling. Coefficients are only recomputed when
+ * SetTimbre() gets a new value.
+ */
+template<Saturation saturation = Saturation::poly>
 class Filter {
 public:
   void Init(float sampleRate) {
-    _flt.Init(sampleRate);
+    _sample_rate = sampleRate;
+    _timbre = -1.f;
+    Reset();
+    SetTimbre(0.f);
+  }
+
+  void Reset() {
+    _s1 = _s2 = _s3 = _s4 = 0.f;
   }
 
   void SetTimbre(float timbre) {
+    if (timbre == _timbre) return;
+    _timbre = timbre;
     auto fltFreq = _map(timbre, 80.f, 16000.f);
     auto fltRes = 1.f - _map(timbre, 0.3f, 1.0f);
-    _flt.SetFreq(fltFreq);
-    _flt.SetRes(fltRes); 
+    _set_coefs(fltFreq, fltRes);
   }
 
   float Process(const float in) {
-    return _flt.Process(in);
+    // Linear estimate of the output resolves the feedback...
+    auto sigma = _b * (_g3 * _s1 + _g2 * _s2 + _g * _s3 + _s4);
+    auto y = (_g4 * in + sigma) * _fb_norm;
+    // ...then the ladder runs on the (saturated) input.
+    auto u = _saturate(in - _k * y);
+    u = _stage(u, _s1);
+    u = _stage(u, _s2);
+    u = _stage(u, _s3);
+    return _stage(u, _s4);
   }
 
 private:
-  daisysp::MoogLadder _flt;
+  static constexpr float kMaxFreq = .45f; // of sample rate
+  static constexpr float kHeadroom = 2.f;
+
+  void _set_coefs(const float freq, const float res) {
+    auto f = fclamp(freq / _sample_rate, 0.f, kMaxFreq);
+    auto g = tanf(static_cast<float>(M_PI) * f);
+    _g = g / (1.f + g);
+    _b = 1.f / (1.f + g);
+    _g2 = _g * _g;
+    _g3 = _g2 * _g;
+    _g4 = _g2 * _g2;
+    _k = 4.f * fclamp(res, 0.f, 1.f);
+    _fb_norm = 1.f / (1.f + _k * _g4);
+  }
+
+  // One TPT pole
+  float _stage(const float x, float& s) {
+    auto v = _g * (x - s);
+    auto y = v + s;
+    s = y + v;
+    return y;
+  }
+
+  static float _saturate(const float x) {
+    if constexpr (saturation == Saturation::tanh) {
+      return kHeadroom * tanhf(x * (1.f / kHeadroom));
+    }
+    else if constexpr (saturation == Saturation::poly) {
+      // x - 4/27 x^3, flat at +/-1.5
+      auto t = fclamp(x * (1.f / kHeadroom), -1.5f, 1.5f);
+      return kHeadroom * (t - (4.f / 27.f) * t * t * t);
+    }
+    else {
+      return x;
+    }
+  }
 
   float _map(float val, float min, float max) {
     return (max - min) * val + min;
   }
+
+  float _sample_rate;
+  float _timbre;
+  float _g, _g2, _g3, _g4;
+  float _b;
+  float _k;
+  float _fb_norm;
+  float _s1, _s2, _s3, _s4;
 };
 
 };
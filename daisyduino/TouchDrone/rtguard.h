@@ -0,0 +1,171 @@
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include <new>
+#include <utility>
+
+namespace synthux {
+
+/**
+ * @brief
+ * Real-time guard for the audio callback.
+ * With RT_GUARD defined it counts heap allocations
+ * (operator new/delete, malloc/free) and blocking calls
+ * (analogRead, delay, Serial) made while the callback runs
+ * and reports them over Serial from loop().
+ * Without RT_GUARD every method compiles to nothing.
+ *
+ * NOTE: Include right after simple-daisy-touch.h, before any
+ * other sketch header, so blocking calls in them are seen.
+ */
+class RTGuard {
+public:
+  enum Violation {
+    kAlloc = 0,
+    kMalloc,
+    kBlocking,
+    kViolationCount
+  };
+
+  // Put on the stack at the top of AudioCallback.
+  class Scope {
+  public:
+    Scope() { RTGuard::Enter(); }
+    ~Scope() { RTGuard::Exit(); }
+  };
+
+  static void Enter() {
+    #ifdef RT_GUARD
+    _in_callback = true;
+    #endif
+  }
+
+  static void Exit() {
+    #ifdef RT_GUARD
+    _in_callback = false;
+    #endif
+  }
+
+  static void Check(const Violation v) {
+    #ifdef RT_GUARD
+    if (_in_callback) _count[v]++;
+    #endif
+  }
+
+  template<class T>
+  static T&& Blocking(T&& call_result) {
+    Check(kBlocking);
+    return std::forward<T>(call_result);
+  }
+
+  static bool HasViolations() {
+    #ifdef RT_GUARD
+    return _count[kAlloc] + _count[kMalloc] + _count[kBlocking] > 0;
+    #else
+    return false;
+    #endif
+  }
+
+  // Call from loop(). Prints only when the counters have changed.
+  static void Report() {
+    #ifdef RT_GUARD
+    uint32_t total = _count[kAlloc] + _count[kMalloc] + _count[kBlocking];
+    if (total == _reported) return;
+    _reported = total;
+    Serial.print("RT GUARD: new/delete ");
+    Serial.print(_count[kAlloc]);
+    Serial.print(", malloc/free ");
+    Serial.print(_count[kMalloc]);
+    Serial.print(", blocking ");
+    Serial.println(_count[kBlocking]);
+    #endif
+  }
+
+private:
+  #ifdef RT_GUARD
+  static inline volatile bool _in_callback = false;
+  static inline volatile uint32_t _count[kViolationCount] = { 0, 0, 0 };
+  static inline uint32_t _reported = 0;
+  #endif
+};
+
+};
+
+#ifdef RT_GUARD
+
+// Replacement allocation functions. They must be defined
+// in exactly one translation unit, i.e. the sketch itself.
+void* operator new(size_t size) {
+  synthux::RTGuard::Check(synthux::RTGuard::kAlloc);
+  return malloc(size);
+}
+
+void* operator new[](size_t size) {
+  synthux::RTGuard::Check(synthux::RTGuard::kAlloc);
+  return malloc(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  synthux::RTGuard::Check(synthux::RTGuard::kAlloc);
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  synthux::RTGuard::Check(synthux::RTGuard::kAlloc);
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  synthux::RTGuard::Check(synthux::RTGuard::kAlloc);
+  free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  synthux::RTGuard::Check(synthux::RTGuard::kAlloc);
+  free(ptr);
+}
+
+// malloc family wrappers, chained to the originals. They only
+// take effect when linked with
+//   -Wl,--wrap=malloc,--wrap=free,--wrap=realloc,--wrap=calloc
+// e.g. through compiler.c.elf.extra_flags in platform.local.txt.
+// Without the flag they're unused and the C heap goes unchecked;
+// operator new and delete above are checked either way.
+extern "C" {
+void* __real_malloc(size_t size);
+void __real_free(void* ptr);
+void* __real_realloc(void* ptr, size_t size);
+void* __real_calloc(size_t count, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  synthux::RTGuard::Check(synthux::RTGuard::kMalloc);
+  return __real_malloc(size);
+}
+
+void __wrap_free(void* ptr) {
+  synthux::RTGuard::Check(synthux::RTGuard::kMalloc);
+  __real_free(ptr);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  synthux::RTGuard::Check(synthux::RTGuard::kMalloc);
+  return __real_realloc(ptr, size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  synthux::RTGuard::Check(synthux::RTGuard::kMalloc);
+  return __real_calloc(count, size);
+}
+}
+
+// Blocking calls. A macro doesn't expand recursively,
+// so the inner name still refers to the original function.
+#define analogRead(pin) synthux::RTGuard::Blocking(analogRead(pin))
+#define delay(ms) (synthux::RTGuard::Check(synthux::RTGuard::kBlocking), delay(ms))
+#ifndef Serial
+#define Serial synthux::RTGuard::Blocking(Serial)
+#else
+#warning "RT_GUARD: Serial is a macro on this core, Serial calls in the callback aren't counted"
+#endif
+
+#endif
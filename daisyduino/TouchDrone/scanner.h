@@ -0,0 +1,97 @@
+#pragma once
+#include <array>
+#include <initializer_list>
+#include <stdint.h>
+
+#include "Arduino.h"
+
+namespace synthux {
+
+// Converts on the board ADC through analogRead().
+class ArduinoAdc {
+public:
+  void Init(const uint8_t pin) {
+    pinMode(pin, INPUT);
+  }
+
+  uint16_t Read(const uint8_t pin) {
+    return analogRead(pin);
+  }
+};
+
+// Returns whatever was Set() for a pin. For running the
+// control code off the board.
+class MockAdc {
+public:
+  MockAdc() {
+    _value.fill(0);
+  }
+
+  void Init(const uint8_t pin) {}
+
+  void Set(const uint8_t pin, const uint16_t value) {
+    _value[pin] = value;
+  }
+
+  uint16_t Read(const uint8_t pin) {
+    return _value[pin];
+  }
+
+private:
+  std::array<uint16_t, 256> _value;
+};
+
+/**
+ * @brief
+ * Keeps the latest conversion of every knob pin in a buffer.
+ * Scan() converts one channel and moves on to the next.
+ * Run it at a fixed rate, e.g. channel_count times per control
+ * tick, so every channel is fresh when the knobs are read
+ * without blocking on the whole set or hogging the ADC.
+ * Knobs read the buffer: AKnob::Process(scanner).
+ */
+template<typename Backend, uint8_t channel_count>
+class AdcScanner {
+public:
+  AdcScanner(std::initializer_list<uint8_t> pins):
+  _next { 0 }
+  {
+    auto ch = 0;
+    for (auto p: pins) {
+      if (ch == channel_count) break;
+      _pin[ch++] = p;
+    }
+    _raw.fill(0);
+  }
+
+  void Init() {
+    for (auto p: _pin) _adc.Init(p);
+    // Fill the buffer once so the first tick sees real values
+    for (auto ch = 0; ch < channel_count; ch++) Scan();
+  }
+
+  void Scan() {
+    _raw[_next] = _adc.Read(_pin[_next]);
+    if (++_next == channel_count) _next = 0;
+  }
+
+  // Latest conversion of the pin, 0 if it isn't scanned.
+  uint16_t Read(const uint8_t pin) const {
+    for (auto ch = 0; ch < channel_count; ch++) {
+      if (_pin[ch] == pin) return _raw[ch];
+    }
+    return 0;
+  }
+
+  Backend& Adc() {
+    return _adc;
+  }
+
+private:
+  Backend _adc;
+  std::array<uint8_t, channel_count> _pin;
+  std::array<uint16_t, channel_count> _raw;
+  uint8_t _next;
+};
+
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <array>
+#include <functional>
+#include <stdint.h>
+
+#include "Arduino.h"
+
+namespace synthux {
+
+/**
+ * @brief
+ * Cooperative fixed-rate scheduler for loop().
+ * Tasks run at multiples of their period measured from Init(),
+ * so timing doesn't drift with how long a task took. A task that
+ * fell more than a period behind skips the missed ticks instead
+ * of running them back to back.
+ */
+template<uint8_t task_count>
+class Scheduler {
+public:
+  Scheduler():
+  _count { 0 }
+  {}
+
+  // Returns false if there's no room for the task.
+  bool Add(const uint32_t period_us, std::function<void()> task) {
+    if (_count == task_count) return false;
+    _task[_count++] = { period_us, 0, task };
+    return true;
+  }
+
+  void Init() {
+    auto now = micros();
+    for (auto i = 0; i < _count; i++) _task[i].next = now;
+  }
+
+  // Call as often as possible.
+  void Run() {
+    for (auto i = 0; i < _count; i++) {
+      auto& t = _task[i];
+      auto now = micros();
+      if (static_cast<int32_t>(now - t.next) < 0) continue;
+      t.next += t.period;
+      if (static_cast<int32_t>(now - t.next) >= 0) t.next = now + t.period;
+      t.run();
+    }
+  }
+
+private:
+  struct Task {
+    uint32_t period;
+    uint32_t next;
+    std::function<void()> run;
+  };
+
+  std::array<Task, task_count> _task;
+  uint8_t _count;
+};
+
+};
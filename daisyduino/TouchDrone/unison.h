@@ -0,0 +1,173 @@
+#pragma once
+#include <array>
+#include <math.h>
+#include <stddef.h>
+
+#include "DaisyDuino.h"
+
+namespace synthux {
+
+/**
+ * @brief
+ * Unison drone: every chord voice of the Driver plays
+ * unison_count detuned band-limited (PolyBLEP) saws.
+ *
+ * Oscillator state lives in flat arrays (phase, detune,
+ * LFO), one slot per oscillator. Process() copies a voice's
+ * unison phases into locals so they stay in registers for the
+ * whole block. Vibrato LFOs run once per block.
+ */
+template<size_t voice_count, size_t unison_count>
+class UnisonDrone {
+public:
+  void Init(const float sample_rate) {
+    _sample_rate_recip = 1.f / sample_rate;
+    // DaisySP Oscillator's default .5 amplitude, so the old
+    // single saw per voice and the unison stack match in RMS
+    _gain = .5f / sqrtf(static_cast<float>(unison_count));
+    _portamento = 1.f;
+    for (size_t k = 0; k < kOscCount; k++) {
+      _phase[k] = random(1000) * .001f;
+      _lfo_phase[k] = random(1000) * .001f;
+      _lfo_inc[k] = random(50, 150) * .1f * _sample_rate_recip;
+      _detune[k] = 1.f;
+      _mult[k] = 1.f;
+    }
+    for (size_t v = 0; v < voice_count; v++) {
+      _freq[v] = 0.f;
+      _target_freq[v] = 0.f;
+      _is_on[v] = false;
+      _is_gliding[v] = false;
+    }
+  }
+
+  void SetPortamento(const float portamento) {
+    if (portamento > 0.995) {
+      _portamento = 1.f;
+    }
+    else {
+      _portamento = fmax(portamento * portamento, 0.05) * 0.0005;
+    }
+  }
+
+  void SetFreq(const size_t voice, const float freq) {
+    _is_on[voice] = (freq > 1.f);
+    _target_freq[voice] = freq;
+    _is_gliding[voice] = true;
+  }
+
+  // Spreads the voice's saws evenly over +/- cents.
+  void SetDetune(const size_t voice, const float cents) {
+    for (size_t u = 0; u < unison_count; u++) {
+      auto pos = unison_count > 1 ? 2.f * u / (unison_count - 1) - 1.f : 0.f;
+      _detune[voice * unison_count + u] = exp2f(pos * cents * (1.f / 1200.f));
+    }
+  }
+
+  // Fills out with size samples.
+  void Process(float* out, size_t size) {
+    while (size > 0) {
+      auto chunk = size < kMaxChunk ? size : kMaxChunk;
+      _process(out, chunk);
+      out += chunk;
+      size -= chunk;
+    }
+  }
+
+private:
+  static constexpr size_t kOscCount = voice_count * unison_count;
+  static constexpr size_t kMaxChunk = 64;
+  static constexpr float kLfoAmount = 0.002f;
+
+  void _process(float* out, const size_t size) {
+    for (size_t i = 0; i < size; i++) out[i] = 0.f;
+
+    // Vibrato, once per chunk
+    for (size_t k = 0; k < kOscCount; k++) {
+      auto ph = _lfo_phase[k] + _lfo_inc[k] * size;
+      ph -= static_cast<float>(static_cast<int>(ph));
+      _lfo_phase[k] = ph;
+      auto tri = 4.f * fabsf(ph - .5f) - 1.f;
+      _mult[k] = _detune[k] * (1.f + tri * kLfoAmount);
+    }
+
+    for (size_t v = 0; v < voice_count; v++) {
+      if (!_is_on[v]) continue;
+      _glide(v, size);
+
+      // Local copies so the compiler keeps them in registers
+      float ph[unison_count];
+      float mult[unison_count];
+      auto base = v * unison_count;
+      for (size_t u = 0; u < unison_count; u++) {
+        ph[u] = _phase[base + u];
+        mult[u] = _mult[base + u];
+      }
+      for (size_t i = 0; i < size; i++) {
+        auto acc = 0.f;
+        for (size_t u = 0; u < unison_count; u++) {
+          auto inc = _inc[i] * mult[u];
+          ph[u] += inc;
+          if (ph[u] >= 1.f) ph[u] -= 1.f;
+          acc += 2.f * ph[u] - 1.f - _blep(ph[u], inc);
+        }
+        out[i] += acc;
+      }
+      for (size_t u = 0; u < unison_count; u++) {
+        _phase[base + u] = ph[u];
+      }
+    }
+
+    for (size_t i = 0; i < size; i++) out[i] *= _gain;
+  }
+
+  // Per sample phase increments of the voice, with portamento.
+  void _glide(const size_t v, const size_t size) {
+    auto freq = _freq[v];
+    for (size_t i = 0; i < size; i++) {
+      if (_is_gliding[v]) {
+        auto delta = _target_freq[v] - freq;
+        if (fabsf(delta) < 0.1f) {
+          freq = _target_freq[v];
+          _is_gliding[v] = false;
+        }
+        else {
+          freq += delta * _portamento;
+        }
+      }
+      _inc[i] = freq * _sample_rate_recip;
+    }
+    _freq[v] = freq;
+  }
+
+  static float _blep(float t, const float dt) {
+    if (t < dt) {
+      t /= dt;
+      return t + t - t * t - 1.f;
+    }
+    if (t > 1.f - dt) {
+      t = (t - 1.f) / dt;
+      return t * t + t + t + 1.f;
+    }
+    return 0.f;
+  }
+
+  std::array<float, kOscCount> _phase;
+  std::array<float, kOscCount> _detune;
+  std::array<float, kOscCount> _mult;
+  std::array<float, kOscCount> _lfo_phase;
+  std::array<float, kOscCount> _lfo_inc;
+
+  std::array<float, voice_count> _freq;
+  std::array<float, voice_count> _target_freq;
+  std::array<bool, voice_count> _is_on;
+  std::array<bool, voice_count> _is_gliding;
+
+  std::array<float, kMaxChunk> _inc;
+
+  float _sample_rate_recip;
+  float _portamento;
+  float _gain;
+};
+
+};
@@ -1,6 +1,16 @@
 // SYNTHUX ACADEMY /////////////////////////////////////////
 // DRUM MACHINE ////////////////////////////////////////////
+// Uncomment to count heap allocations and
+// blocking calls made in the audio callback.
+// #define RT_GUARD
+
+// Uncomment to render the drums into SDRAM at boot
+// and play hits back from there. Costs a couple of
+// seconds at startup, saves most of the drum CPU.
+// #define DRUM_CACHE
+
 #include "simple-daisy-touch.h"
+#include "rtguard.h"
 #include "aknob.h"
 #include "onoffon.h"
 #include "mvalue.h"
@@ -11,7 +21,11 @@
 #include "simplesd.h"
 #include "simplehh.h"
 #include "click.h"
+#ifdef DRUM_CACHE
+#include "cache.h"
+#endif
 #include "xfade.h"
+#include "engine.h"
 
 using namespace synthux;
 using namespace simpletouch;
@@ -76,6 +90,12 @@ static const uint16_t kSDPadA = 6;
 static const uint16_t kSDPadB = 7;
 static const uint16_t kHHPadA = 8;
 static const uint16_t kHHPadB = 9;
+// Two pads per drum: tone A and tone B
+static const array<array<uint16_t, 2>, kDrumCount> kDrumPads = {{
+  { kBDPadA, kBDPadB },
+  { kSDPadA, kSDPadB },
+  { kHHPadA, kHHPadB }
+}};
 static const uint16_t kRecordPad = 10;
 static const uint16_t kClearingPad = 11;
 
@@ -87,21 +107,66 @@ static const uint16_t kClearingPad = 11;
 static const int clock_pin = D(S31);
 #endif
 
+// Uncomment to send MIDI clock, start and stop on
+// Serial1 (31250 baud), so other gear can follow.
+// #define MIDI_CLOCK_OUT
+
+#ifdef MIDI_CLOCK_OUT
+// How often the due MIDI bytes are sent, Hz.
+static const uint32_t kMidiFlushRate = 10000;
+#endif
+
+// Uncomment to run the external clock PLL against
+// synthetic jittery clocks and print the phase error
+// over Serial at boot.
+// #define PLL_BENCH
+
+#ifdef PLL_BENCH
+#include "pllbench.h"
+#endif
+
+// Uncomment to time the drum engine with 8 busy
+// tracks and print its CPU load over Serial at boot.
+// #define ENGINE_BENCH
+
+#ifdef ENGINE_BENCH
+#include "enginebench.h"
+#endif
+
 ///////////////////////////////////////////////////////////////
 ///////////////////////// MODULES /////////////////////////////
 static constexpr size_t kPPQN = 48;
 
 static SyncClock<kPPQN> clck;
+#ifdef EXTERNAL_SYNC
+static ClockIn<> clock_in;
+#endif
+#ifdef MIDI_CLOCK_OUT
+static MidiClockOut<kPPQN> midi_clock;
+static HardwareTimer midi_timer(TIM5);
+#endif
 static Trigger trigger(kPPQN, Every::_32th);
 
-static Track bd_track;
-static Track sd_track;
-static Track hh_track;
+static array<Track, kDrumCount> tracks;
 
 static Click click;
+#ifdef DRUM_CACHE
+static constexpr size_t kCacheTones = 32;
+static constexpr size_t kBDCacheLength = 19200; // 400ms @ 48K
+static constexpr size_t kSDCacheLength = 14400; // 300ms @ 48K
+static constexpr size_t kHHCacheLength = 48000; // 1s @ 48K
+static float DSY_SDRAM_BSS bd_cache[kCacheTones * kBDCacheLength];
+static float DSY_SDRAM_BSS sd_cache[kCacheTones * kSDCacheLength];
+static float DSY_SDRAM_BSS hh_cache[kCacheTones * kHHCacheLength];
+static CachedDrum<SimpleBD, kCacheTones> bd(bd_cache, kBDCacheLength);
+static CachedDrum<SimpleSD, kCacheTones> sd(sd_cache, kSDCacheLength);
+static CachedDrum<SimpleHH, kCacheTones> hh(hh_cache, kHHCacheLength);
+#else
 static SimpleBD bd;
 static SimpleSD sd;
 static SimpleHH hh;
+#endif
+static DrumEngine<kDrumCount> drums;
 
 static ReverbSc verb;
 static XFade xfade;
@@ -109,16 +174,9 @@ static XFade xfade;
 ///////////////////////////////////////////////////////////////
 //////////////////////// VARIABLES ////////////////////////////
 static constexpr float kToneOffset = 0.09;
-bool trig[kDrumCount] = { false, false, false };
-float tones[kDrumCount] = { .5f, .5f, .5f };
 float tonesA[kDrumCount] = { .41f, .41f, .41f }; //tones - timbre offset
 float tonesB[kDrumCount] = { .59f, .59f, .59f }; //tones + timbre offset
 float mix_kof[kDrumCount] = { 1.f, .4f, .5f }; //bd, sd, hh
-float mix_volume[kDrumCount][2] = { 
-  { mix_kof[BD], mix_kof[BD] },
-  { mix_kof[SD], mix_kof[SD] },
-  { mix_kof[HH], mix_kof[HH] }
-};
 
 size_t click_cnt = 0;
 auto click_trig = false;
@@ -134,24 +192,24 @@ auto is_clearing = false;
 ////////////////////// TOUCH CALLBACKS ////////////////////////
 void OnPadTouch(uint16_t pad) {
   switch (pad) {
-    case kPlayStopPad: ToggleClock(); break;
-    case kBDPadA: if (!is_clearing) { tones[BD] = tonesA[BD]; bd_track.HitStroke(tones[BD]); trig[BD] = true; } break;
-    case kBDPadB: if (!is_clearing) { tones[BD] = tonesB[BD]; bd_track.HitStroke(tones[BD]); trig[BD] = true; } break;
-    case kSDPadA: if (!is_clearing) { tones[SD] = tonesA[SD]; sd_track.HitStroke(tones[SD]); trig[SD] = true; } break;
-    case kSDPadB: if (!is_clearing) { tones[SD] = tonesB[SD]; sd_track.HitStroke(tones[SD]); trig[SD] = true; } break;
-    case kHHPadA: if (!is_clearing) { tones[HH] = tonesA[HH]; hh_track.HitStroke(tones[HH]); trig[HH] = true; } break;
-    case kHHPadB: if (!is_clearing) { tones[HH] = tonesB[HH]; hh_track.HitStroke(tones[HH]); trig[HH] = true; } break;
-    case kRecordPad: ToggleRecording(); break;
-    case kClickPad: ToggleClick(); break;
+    case kPlayStopPad: ToggleClock(); return;
+    case kRecordPad: ToggleRecording(); return;
+    case kClickPad: ToggleClick(); return;
   };
+  if (is_clearing) return;
+  for (auto i = 0; i < kDrumCount; i++) {
+    auto& pads = kDrumPads[i];
+    if (pad != pads[0] && pad != pads[1]) continue;
+    auto tone = pad == pads[0] ? tonesA[i] : tonesB[i];
+    tracks[i].HitStroke(tone);
+    drums.Post(i, tone);
+  }
 }
 
 void ToggleClock() {
   if (clck.IsRunning()) {
     clck.Stop();
-    bd_track.Reset();
-    sd_track.Reset();
-    hh_track.Reset();
+    for (auto& t: tracks) t.Reset();
     trigger.Reset();
     click.Reset();
     click_cnt = 0;
@@ -163,9 +221,7 @@ void ToggleClock() {
 
 void ToggleRecording() {
   is_recording = !is_recording;
-  bd_track.SetRecording(is_recording);
-  sd_track.SetRecording(is_recording);
-  hh_track.SetRecording(is_recording);
+  for (auto& t: tracks) t.SetRecording(is_recording);
 }
 
 void ToggleClick() {
@@ -187,43 +243,51 @@ void OnClockTick() {
   
   if (!trigger.Tick()) return;
 
-  if (bd_track.Tick()) { trig[BD] = true; tones[BD] = bd_track.AutomationValue(); }
-  if (sd_track.Tick()) { trig[SD] = true; tones[SD] = sd_track.AutomationValue(); }
-  if (hh_track.Tick()) { trig[HH] = true; tones[HH] = hh_track.AutomationValue(); }
+  // A 32nd, swing aside
+  auto tick_length = 7.5f / clck.Tempo();
+  for (auto i = 0; i < kDrumCount; i++) {
+    auto& t = tracks[i];
+    if (t.Tick()) drums.Trigger(i, t.AutomationValue(), t.Velocity(), t.Delay(tick_length));
+  }
 }
 
+#ifdef EXTERNAL_SYNC
+// Pin interrupt, keep it short.
+void OnClockEdge() {
+  clock_in.Capture();
+}
+#endif
+
+#ifdef MIDI_CLOCK_OUT
+// Timer interrupt
+void OnMidiTimer() {
+  midi_clock.Flush(Serial1);
+}
+#endif
+
 ///////////////////////////////////////////////////////////////
 ///////////////////// AUDIO CALLBACK //////////////////////////
 float click_out;
-float drum_out[kDrumCount];
 float verb_in[2];
 float verb_out[2];
 float bus[2];
 void AudioCallback(float **in, float **out, size_t size) {  
+  RTGuard::Scope rt_guard;
+  #ifdef EXTERNAL_SYNC
+  //Sync to the captured clock edges
+  uint32_t edge;
+  while (clock_in.Pop(edge)) clck.Sync(edge, micros());
+  #endif
+
   //Advance clock
   clck.Tick();
 
-  //Set timbre
-  if (trig[BD]) bd.SetTone(tones[BD]);
-  if (trig[SD]) sd.SetTone(tones[SD]);
-  if (trig[HH]) hh.SetTone(tones[HH]);
+  //Render and mix drum tracks
+  drums.Process(out[0], out[1], size);
   
   for (auto i = 0; i < size; i++) {
-    // Zero out as there's no guarantee that the buffer
-    // is supplied with zero values.
-    
-    //Mix drum tracks
-    drum_out[BD] = bd.Process(trig[BD]);
-    drum_out[SD] = sd.Process(trig[SD]); 
-    drum_out[HH] = hh.Process(trig[HH]);
-
-    bus[0] = bus[1] = 0;
-
-    for (auto k = 0; k < kDrumCount; k++) {
-      bus[0] += drum_out[k] * mix_volume[k][0];
-      bus[1] += drum_out[k] * mix_volume[k][1];  
-      trig[k] = false;
-    }
+    bus[0] = out[0][i];
+    bus[1] = out[1][i];
 
     xfade.Process(0, 0, bus[0], bus[1], verb_in[0], verb_in[1]);
     verb.Process(verb_in[0], verb_in[1], &(verb_out[0]), &(verb_out[1]));
@@ -253,13 +317,39 @@ void setup() {
   clck.Init(sample_rate, buffer_size);
   clck.SetOnTick(OnClockTick);
   #ifdef EXTERNAL_SYNC
-  pinMode(clock_pin, INPUT);
+  clock_in.Init(clock_pin, OnClockEdge);
+  #endif
+
+  #ifdef MIDI_CLOCK_OUT
+  Serial1.begin(31250);
+  midi_clock.Init(sample_rate, buffer_size);
+  clck.SetMidiOut(&midi_clock);
+  midi_timer.setOverflow(kMidiFlushRate, HERTZ_FORMAT);
+  midi_timer.attachInterrupt(OnMidiTimer);
+  midi_timer.resume();
+  #endif
+
+  #ifdef PLL_BENCH
+  PllBench().Run();
+  #endif
+
+  #ifdef ENGINE_BENCH
+  static EngineBench engine_bench;
+  engine_bench.Run(sample_rate, buffer_size);
   #endif
 
   bd.Init(sample_rate);
   sd.Init(sample_rate);
   hh.Init(sample_rate);
 
+  drums.Init(sample_rate);
+  drums.AddVoice(BD, bd);
+  drums.AddVoice(SD, sd);
+  drums.AddVoice(HH, hh);
+  for (auto i = 0; i < kDrumCount; i++) {
+    drums.SetMix(i, mix_kof[i], mix_kof[i]);
+  }
+
   verb.Init(sample_rate);
   verb.SetFeedback(0.4);
   verb.SetLpFreq(10000.f);
@@ -291,18 +381,15 @@ void loop() {
   tempo = tempo_knob.Process();
   clck.SetTempo(tempo);
 
-  #ifdef EXTERNAL_SYNC
-  clck.Process(!digitalRead(clock_pin));
-  #endif
-
   trigger.SetSwing(swing_knob.Process());
 
   touch.Process();
 
   is_clearing = touch.IsTouched(kClearingPad);
-  bd_track.SetClearing(is_clearing && (touch.IsTouched(kBDPadA) || touch.IsTouched(kBDPadB)));
-  sd_track.SetClearing(is_clearing && (touch.IsTouched(kSDPadA) || touch.IsTouched(kSDPadB)));
-  hh_track.SetClearing(is_clearing && (touch.IsTouched(kHHPadA) || touch.IsTouched(kHHPadB)));
+  for (auto i = 0; i < kDrumCount; i++) {
+    auto& pads = kDrumPads[i];
+    tracks[i].SetClearing(is_clearing && (touch.IsTouched(pads[0]) || touch.IsTouched(pads[1])));
+  }
   
   xfade.SetStage(verb_knob.Process());
 
@@ -327,12 +414,13 @@ void loop() {
       pan1 = 1.f;  
       if (pan < 0.47f) pan1 = 2.f * pan;
       else if (pan > 0.53f) pan0 = 2.f * (1.f - pan);
-      mix_volume[i][0] = volume * pan0;
-      mix_volume[i][1] = volume * pan1;
+      drums.SetMix(i, volume * pan0, volume * pan1);
   }
   }
 
   digitalWrite(LED_BUILTIN, is_recording && blink || is_clearing);
 
+  RTGuard::Report();
+
   delay(4);
 }
@@ -0,0 +1,100 @@
+#pragma once
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "DaisyDuino.h"
+
+namespace synthux {
+
+/**
+ * @brief
+ * Plays a drum from renders made at boot instead of
+ * synthesising every hit. Init() renders the drum at tone_count
+ * tone values spread evenly over 0...1 into the buffer (SDRAM,
+ * tone_count * length samples). A hit reads the two renders around
+ * its tone and blends them. A retrigger fades the previous hit out
+ * over kFadeLength instead of cutting it.
+ *
+ * Same interface as the drum, so it's a drop-in:
+ * Init(), SetTone(), Process(trigger).
+ * SetTone() applies from the next hit.
+ */
+template<typename Drum, size_t tone_count>
+class CachedDrum {
+public:
+  CachedDrum(float* buffer, const size_t length):
+  _buffer { buffer },
+  _length { length },
+  _tone   { .5f },
+  _fade   { 0 }
+  {
+    _hit.pos = _length;
+    _fading.pos = _length;
+  }
+
+  // Renders every tone, blocks for a while.
+  void Init(const float sample_rate) {
+    _drum.Init(sample_rate);
+    for (size_t t = 0; t < tone_count; t++) {
+      _drum.SetTone(static_cast<float>(t) / (tone_count - 1));
+      auto row = _buffer + t * _length;
+      for (size_t i = 0; i < _length; i++) row[i] = _drum.Process(i == 0);
+      // Fade the tail so a long decay doesn't end on a step
+      for (size_t i = 0; i < kFadeLength; i++) {
+        row[_length - 1 - i] *= static_cast<float>(i) / kFadeLength;
+      }
+    }
+  }
+
+  void SetTone(const float value) {
+    _tone = fclamp(value, 0.f, 1.f);
+  }
+
+  float Process(const bool trigger) {
+    if (trigger) {
+      _fading = _hit;
+      _fade = kFadeLength;
+      auto pos = _tone * (tone_count - 1);
+      auto row = std::min(static_cast<size_t>(pos), tone_count - 2);
+      _hit.row = _buffer + row * _length;
+      _hit.mix = pos - row;
+      _hit.pos = 0;
+    }
+    auto out = _read(_hit);
+    if (_fade > 0) {
+      out += _read(_fading) * (_fade * (1.f / kFadeLength));
+      _fade--;
+    }
+    return out;
+  }
+
+private:
+  static_assert(tone_count >= 2, "Need at least two tones to blend");
+  static constexpr size_t kFadeLength = 48; // 1ms @ 48K
+
+  struct Hit {
+    const float* row;
+    float mix;
+    size_t pos;
+  };
+
+  // Blend of the render below and above the tone.
+  float _read(Hit& hit) {
+    if (hit.pos >= _length) return 0.f;
+    auto a = hit.row[hit.pos];
+    auto b = hit.row[hit.pos + _length];
+    hit.pos++;
+    return a + hit.mix * (b - a);
+  }
+
+  Drum _drum;
+  float* _buffer;
+  size_t _length;
+  Hit _hit;
+  Hit _fading;
+  float _tone;
+  size_t _fade;
+};
+
+};
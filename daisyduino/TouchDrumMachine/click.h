@@ -1,6 +1,7 @@
 #pragma once
 
 #include "DaisyDuino.h"
+#include "wavetable.h"
 
 namespace synthux {
 
@@ -13,7 +14,7 @@ public:
     _env.SetTime(ADSR_SEG_RELEASE, .01);
     _env.SetSustainLevel(1.0);
     _osc.Init(sample_rate);
-    _osc.SetWaveform(Oscillator::WAVE_TRI);
+    _osc.SetWaveform(Waveform::tri);
     _osc.SetFreq(100.0);
   }
 
@@ -39,7 +40,7 @@ public:
 
 private:
   Adsr _env;
-  Oscillator _osc;
+  WaveOsc _osc;
   size_t _counter = _kBeat_counts;
   static constexpr size_t _kBeat_counts = 3;
 };
@@ -0,0 +1,154 @@
+#pragma once
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "Arduino.h"
+
+namespace synthux {
+
+/**
+ * @brief
+ * External clock input captured by a pin interrupt.
+ * Each falling edge (the jack input is inverted) stores its
+ * micros() timestamp in a small ring, so the edge time doesn't
+ * depend on how often loop() or the audio callback look at it.
+ * The ISR is a plain function in the sketch calling Capture(),
+ * the audio callback drains the ring with Pop(). Each side
+ * publishes its index with release and reads the other's with
+ * acquire, so a popped stamp is always the one pushed.
+ */
+template<size_t capacity = 8>
+class ClockIn {
+public:
+  ClockIn():
+  _head { 0 },
+  _tail { 0 }
+  {}
+
+  void Init(const int pin, void(*isr)()) {
+    pinMode(pin, INPUT);
+    attachInterrupt(digitalPinToInterrupt(pin), isr, FALLING);
+  }
+
+  // From the ISR.
+  void Capture() {
+    Push(micros());
+  }
+
+  // Drops the edge if the ring is full.
+  void Push(const uint32_t time_us) {
+    auto head = _head.load(std::memory_order_relaxed);
+    auto next = (head + 1) & kMask;
+    if (next == _tail.load(std::memory_order_acquire)) return;
+    _stamp[head] = time_us;
+    _head.store(next, std::memory_order_release);
+  }
+
+  bool Pop(uint32_t& time_us) {
+    auto tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) return false;
+    time_us = _stamp[tail];
+    _tail.store((tail + 1) & kMask, std::memory_order_release);
+    return true;
+  }
+
+private:
+  static_assert((capacity & (capacity - 1)) == 0, "Capacity must be a power of 2");
+  static constexpr size_t kMask = capacity - 1;
+
+  uint32_t _stamp[capacity];
+  std::atomic<size_t> _head;
+  std::atomic<size_t> _tail;
+};
+
+/**
+ * @brief
+ * Second order (alpha-beta) PLL on clock edge timestamps.
+ * Each edge is compared with the predicted one; a part of the
+ * error moves the phase, a smaller part the period. Edge jitter
+ * is smoothed out while tempo changes are followed within a few
+ * pulses. Two edges lock it. Edges far off the prediction are
+ * dropped as glitches; kMaxMisses of them in a row, or a gap of
+ * kTimeout periods, relock on the next pulse.
+ */
+class ClockPll {
+public:
+  ClockPll():
+  _edge   { 0 },
+  _period { 0.f },
+  _error  { 0.f },
+  _count  { 0 },
+  _misses { 0 }
+  {}
+
+  void Reset() {
+    _count = 0;
+    _misses = 0;
+    _error = 0.f;
+  }
+
+  // Returns false if the edge was dropped.
+  bool Process(const uint32_t edge_us) {
+    auto since = static_cast<float>(static_cast<int32_t>(edge_us - _edge));
+    if (_count == 0 || since <= 0.f || (_count > 1 && since > _period * kTimeout)) {
+      _relock(edge_us);
+      return true;
+    }
+
+    if (_count == 1) {
+      _period = since;
+      _edge = edge_us;
+      _count = 2;
+      return true;
+    }
+
+    auto error = since - _period;
+    if (fabsf(error) > _period * kCaptureRange) {
+      if (++_misses < kMaxMisses) return false;
+      _relock(edge_us);
+      return true;
+    }
+
+    _misses = 0;
+    _error = error;
+    _edge += static_cast<int32_t>(_period + kAlpha * error + .5f);
+    _period += kBeta * error;
+    return true;
+  }
+
+  bool IsLocked() const { return _count > 1; }
+
+  // Filtered time of the last edge, micros().
+  uint32_t Edge() const { return _edge; }
+
+  // Filtered edge interval, us.
+  float Period() const { return _period; }
+
+  // Last edge against the prediction, us.
+  float Error() const { return _error; }
+
+private:
+  static constexpr float kAlpha = .4f;
+  // Critically damped for kAlpha
+  static constexpr float kBeta = kAlpha * kAlpha / (2.f - kAlpha);
+  static constexpr float kCaptureRange = .25f;
+  static constexpr float kTimeout = 4.f;
+  static constexpr uint8_t kMaxMisses = 2;
+
+  void _relock(const uint32_t edge_us) {
+    _edge = edge_us;
+    _count = 1;
+    _misses = 0;
+    _error = 0.f;
+  }
+
+  uint32_t _edge;
+  float _period;
+  float _error;
+  uint8_t _count;
+  uint8_t _misses;
+};
+
+};
@@ -0,0 +1,311 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace synthux {
+
+/**
+ * @brief
+ * Drum tracks rendered a block at a time and mixed to stereo.
+ *
+ * Any drum with SetTone(tone) and Process(trigger) can be added
+ * to a track. Adding several voices to a track makes it
+ * polyphonic: hits go round robin, so tails ring on.
+ * Tracks in the same choke group cut each other (open/closed
+ * hat): a hit fades the other tracks' voices out over kChokeTime.
+ * A choked voice keeps running unheard until its output dies
+ * away, so its envelope doesn't freeze mid decay and come back
+ * on the next hit; then it isn't rendered until it's hit again.
+ *
+ * Hits can land anywhere in a block, up to a delay given with
+ * the trigger, and set the voice level (velocity). Each track
+ * queues up to kMaxHits of them in time order, so a hit that's
+ * still waiting out its delay isn't lost to the next one.
+ * Trigger() is for the audio callback only; loop() hands hits
+ * over with Post(), through a lock-free single producer inbox.
+ *
+ * Each track renders into its own buffer, then a single pass
+ * per track applies its left/right gains to the whole block.
+ */
+template<size_t track_count, size_t max_voices = 2>
+class DrumEngine {
+public:
+  static constexpr uint8_t kNoChoke = 0xff;
+
+  DrumEngine():
+  _sample_rate  { 48000.f },
+  _choke_step   { 1.f },
+  _now          { 0 },
+  _inbox_head   { 0 },
+  _inbox_tail   { 0 }
+  {
+    _voice_count.fill(0);
+    _next_voice.fill(0);
+    _choke_group.fill(kNoChoke);
+    _hit_count.fill(0);
+    _tone.fill(.5f);
+    _velocity.fill(1.f);
+    _left.fill(1.f);
+    _right.fill(1.f);
+    // Voices stay silent, and cost nothing, until their first hit
+    for (auto& g: _gain) g.fill(0.f);
+    for (auto& s: _step) s.fill(0.f);
+    for (auto& r: _ramp_at) r.fill(0);
+    for (auto& d: _is_draining) d.fill(false);
+  }
+
+  void Init(const float sample_rate) {
+    _sample_rate = sample_rate;
+    _choke_step = 1.f / (kChokeTime * sample_rate);
+  }
+
+  // Returns false if the track has no room for another voice.
+  template<typename Voice>
+  bool AddVoice(const size_t track, Voice& voice) {
+    auto& count = _voice_count[track];
+    if (count == max_voices) return false;
+    _voices[track][count++] = { &voice, &_render<Voice> };
+    return true;
+  }
+
+  void SetChokeGroup(const size_t track, const uint8_t group) {
+    _choke_group[track] = group;
+  }
+
+  void SetMix(const size_t track, const float left, const float right) {
+    _left[track] = left;
+    _right[track] = right;
+  }
+
+  // Audio callback only. The hit lands at the start of the next
+  // block, or delay seconds after it. Returns false, dropping
+  // the hit, if the track already has kMaxHits waiting.
+  bool Trigger(const size_t track, const float tone, const float velocity = 1.f, const float delay = 0.f) {
+    auto& count = _hit_count[track];
+    if (count == kMaxHits) return false;
+    auto& hits = _hits[track];
+    Hit hit = { _now + static_cast<uint32_t>(delay * _sample_rate), tone, velocity };
+    // Keep them in time order, a later trigger can land earlier
+    auto i = count++;
+    for (; i > 0 && static_cast<int32_t>(hits[i - 1].due - hit.due) > 0; i--) hits[i] = hits[i - 1];
+    hits[i] = hit;
+    return true;
+  }
+
+  // From loop(): the hit lands at the start of the next block.
+  // Returns false, dropping the hit, if the inbox is full.
+  bool Post(const size_t track, const float tone, const float velocity = 1.f) {
+    auto head = _inbox_head.load(std::memory_order_relaxed);
+    auto next = (head + 1) & kInboxMask;
+    if (next == _inbox_tail.load(std::memory_order_acquire)) return false;
+    _inbox[head] = { track, tone, velocity };
+    _inbox_head.store(next, std::memory_order_release);
+    return true;
+  }
+
+  void Process(float* left, float* right, size_t size) {
+    _drain_inbox();
+    while (size > 0) {
+      auto chunk = std::min(size, kMaxBlock);
+      // A voice takes one hit per chunk, so the
+      // chunk ends where a second hit is due
+      for (size_t t = 0; t < track_count; t++) {
+        if (_hit_count[t] < 2) continue;
+        auto until = static_cast<int32_t>(_hits[t][1].due - _now);
+        if (until > 0) chunk = std::min(chunk, static_cast<size_t>(until));
+      }
+      _process(left, right, chunk);
+      _now += chunk;
+      left += chunk;
+      right += chunk;
+      size -= chunk;
+    }
+  }
+
+private:
+  static constexpr size_t kMaxBlock = 64;
+  static constexpr size_t kMaxHits = 4;
+  static constexpr size_t kInboxSize = 16;
+  static constexpr size_t kInboxMask = kInboxSize - 1;
+  static constexpr float kChokeTime = .005f; // s
+  static constexpr float kSilence = .0001f; // -80 dB
+
+  struct Hit {
+    uint32_t due;
+    float tone;
+    float velocity;
+  };
+
+  struct PostedHit {
+    size_t track;
+    float tone;
+    float velocity;
+  };
+
+  struct VoiceRef {
+    void* object;
+    void (*render)(void* object, float tone, size_t hit_at, float* out, size_t size);
+  };
+
+  // hit_at >= size means no hit in this block.
+  template<typename Voice>
+  static void _render(void* object, const float tone, const size_t hit_at, float* out, const size_t size) {
+    auto& voice = *static_cast<Voice*>(object);
+    auto i = 0u;
+    for (; i < size && i < hit_at; i++) out[i] = voice.Process(false);
+    if (i == size) return;
+    voice.SetTone(tone);
+    out[i++] = voice.Process(true);
+    for (; i < size; i++) out[i] = voice.Process(false);
+  }
+
+  // A non zero step ramps the gain down from ramp_at on.
+  static void _accumulate(float* track, const float* in, size_t from, const size_t to, float& gain, float& step, const size_t ramp_at = 0) {
+    auto hold = step == 0.f ? to : std::min(std::max(from, ramp_at), to);
+    for (; from < hold; from++) track[from] += in[from] * gain;
+    if (from == to) return;
+    for (; from < to; from++) {
+      track[from] += in[from] * gain;
+      gain = std::max(gain - step, 0.f);
+    }
+    if (gain == 0.f) step = 0.f;
+  }
+
+  void _process(float* left, float* right, const size_t size) {
+    // Hits first, so a choke and a hit in the same block
+    // don't depend on the track order.
+    std::array<int8_t, track_count> hit_voice;
+    std::array<size_t, track_count> hit_at;
+    for (size_t t = 0; t < track_count; t++) {
+      hit_voice[t] = -1;
+      hit_at[t] = size;
+      if (_voice_count[t] == 0) {
+        _hit_count[t] = 0;
+        continue;
+      }
+      // Hits due on the same sample merge, the last one wins
+      auto& hits = _hits[t];
+      auto popped = 0u;
+      while (popped < _hit_count[t] && static_cast<int32_t>(hits[popped].due - _now) < static_cast<int32_t>(size)) {
+        auto& hit = hits[popped++];
+        hit_at[t] = static_cast<int32_t>(hit.due - _now) > 0 ? hit.due - _now : 0;
+        _tone[t] = hit.tone;
+        _velocity[t] = hit.velocity;
+      }
+      if (popped == 0) continue;
+      for (auto i = popped; i < _hit_count[t]; i++) hits[i - popped] = hits[i];
+      _hit_count[t] -= popped;
+      hit_voice[t] = _next_voice[t];
+      if (++_next_voice[t] == _voice_count[t]) _next_voice[t] = 0;
+    }
+    for (size_t t = 0; t < track_count; t++) {
+      if (hit_voice[t] >= 0 && _choke_group[t] != kNoChoke) _choke(t, hit_at[t], hit_voice, hit_at);
+    }
+
+    for (size_t t = 0; t < track_count; t++) {
+      auto track = _track[t].data();
+      std::fill(track, track + size, 0.f);
+      for (uint8_t v = 0; v < _voice_count[t]; v++) {
+        auto& gain = _gain[t][v];
+        auto& step = _step[t][v];
+        auto& ramp_at = _ramp_at[t][v];
+        auto& is_draining = _is_draining[t][v];
+        auto& voice = _voices[t][v];
+        auto at = hit_voice[t] == v ? hit_at[t] : size;
+        if (gain <= 0.f && at == size) {
+          ramp_at = 0;
+          if (is_draining) is_draining = _drain(voice, size);
+          continue;
+        }
+        voice.render(voice.object, _tone[t], at, _scratch.data(), size);
+        // Old level up to the hit, velocity from there
+        _accumulate(track, _scratch.data(), 0, at, gain, step, ramp_at);
+        if (at < size) {
+          gain = _velocity[t];
+          // Choked later in the block by another track
+          step = ramp_at > at ? _choke_step : 0.f;
+          _accumulate(track, _scratch.data(), at, size, gain, step, ramp_at);
+        }
+        ramp_at = 0;
+        // Faded out, by a choke or a zero velocity hit
+        is_draining = gain <= 0.f;
+      }
+    }
+
+    // Mix, one pass per track
+    std::fill(left, left + size, 0.f);
+    std::fill(right, right + size, 0.f);
+    for (size_t t = 0; t < track_count; t++) {
+      auto track = _track[t].data();
+      auto l = _left[t];
+      auto r = _right[t];
+      for (size_t i = 0; i < size; i++) {
+        left[i] += track[i] * l;
+        right[i] += track[i] * r;
+      }
+    }
+  }
+
+  // The other tracks of the group fade from sample at of the block,
+  // including a voice of theirs that's hit earlier in it.
+  void _choke(const size_t hit_track, const size_t at, const std::array<int8_t, track_count>& hit_voice, const std::array<size_t, track_count>& hit_at) {
+    for (size_t t = 0; t < track_count; t++) {
+      if (t == hit_track || _choke_group[t] != _choke_group[hit_track]) continue;
+      for (uint8_t v = 0; v < _voice_count[t]; v++) {
+        auto is_hit_before = hit_voice[t] == v && hit_at[t] < at;
+        if (_gain[t][v] <= 0.f && !is_hit_before) continue;
+        _step[t][v] = _choke_step;
+        _ramp_at[t][v] = at;
+      }
+    }
+  }
+
+  // Renders a silenced voice into the scratch buffer and
+  // returns false once its output has died away.
+  bool _drain(const VoiceRef& voice, const size_t size) {
+    voice.render(voice.object, 0.f, size, _scratch.data(), size);
+    for (size_t i = 0; i < size; i++) {
+      if (fabsf(_scratch[i]) >= kSilence) return true;
+    }
+    return false;
+  }
+
+  void _drain_inbox() {
+    auto tail = _inbox_tail.load(std::memory_order_relaxed);
+    auto head = _inbox_head.load(std::memory_order_acquire);
+    for (; tail != head; tail = (tail + 1) & kInboxMask) {
+      auto& hit = _inbox[tail];
+      Trigger(hit.track, hit.tone, hit.velocity);
+    }
+    _inbox_tail.store(tail, std::memory_order_release);
+  }
+
+  std::array<std::array<VoiceRef, max_voices>, track_count> _voices;
+  std::array<std::array<float, max_voices>, track_count> _gain;
+  std::array<std::array<float, max_voices>, track_count> _step;
+  std::array<std::array<size_t, max_voices>, track_count> _ramp_at;
+  std::array<std::array<bool, max_voices>, track_count> _is_draining;
+  std::array<std::array<Hit, kMaxHits>, track_count> _hits;
+  std::array<PostedHit, kInboxSize> _inbox;
+  std::array<std::array<float, kMaxBlock>, track_count> _track;
+  std::array<float, kMaxBlock> _scratch;
+  std::array<uint8_t, track_count> _voice_count;
+  std::array<uint8_t, track_count> _next_voice;
+  std::array<uint8_t, track_count> _choke_group;
+  std::array<uint8_t, track_count> _hit_count;
+  std::array<float, track_count> _tone;
+  std::array<float, track_count> _velocity;
+  std::array<float, track_count> _left;
+  std::array<float, track_count> _right;
+  float _sample_rate;
+  float _choke_step;
+  uint32_t _now;
+  std::atomic<size_t> _inbox_head;
+  std::atomic<size_t> _inbox_tail;
+};
+
+};
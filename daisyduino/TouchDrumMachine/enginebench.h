@@ -0,0 +1,79 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "DaisyDuino.h"
+#include "load.h"
+#include "engine.h"
+#include "simplebd.h"
+#include "simplesd.h"
+#include "simplehh.h"
+
+namespace synthux {
+
+/**
+ * @brief
+ * Times a DrumEngine with kTracks tracks, BD, SD and HH in
+ * turn, every track hit on every 16th at 120 bpm, and prints
+ * the engine's share of the block budget over Serial.
+ * Only the engine is timed, the reverb and the sequencer come
+ * on top. Device only: enable ENGINE_BENCH in
+ * TouchDrumMachine.ino and it runs once from setup().
+ */
+class EngineBench {
+public:
+  static constexpr size_t kTracks = 8;
+
+  void Run(const float sample_rate, size_t block_size) {
+    block_size = std::min(block_size, kMaxBlockSize);
+    for (auto& v: _bd) v.Init(sample_rate);
+    for (auto& v: _sd) v.Init(sample_rate);
+    for (auto& v: _hh) v.Init(sample_rate);
+
+    _engine.Init(sample_rate);
+    for (size_t t = 0; t < kTracks; t++) {
+      switch (t % 3) {
+        case 0: _engine.AddVoice(t, _bd[t / 3]); break;
+        case 1: _engine.AddVoice(t, _sd[t / 3]); break;
+        default: _engine.AddVoice(t, _hh[t / 3]); break;
+      }
+      _engine.SetMix(t, .3f, .3f);
+    }
+
+    CpuLoad load;
+    load.Init(sample_rate, block_size);
+    auto step = static_cast<size_t>(kStepTime * sample_rate);
+    auto blocks = static_cast<size_t>(kSeconds * sample_rate / block_size);
+    size_t next_step = 0;
+    for (size_t b = 0; b < blocks; b++) {
+      load.Begin();
+      if (b * block_size >= next_step) {
+        for (size_t t = 0; t < kTracks; t++) _engine.Trigger(t, .5f);
+        next_step += step;
+      }
+      _engine.Process(_left.data(), _right.data(), block_size);
+      load.End();
+    }
+
+    Serial.print("BENCH: engine, ");
+    Serial.print(kTracks);
+    Serial.print(" tracks, ");
+    load.Report();
+  }
+
+private:
+  static constexpr size_t kMaxBlockSize = 256;
+  static constexpr float kStepTime = .125f; // s, 16ths at 120 bpm
+  static constexpr float kSeconds = 4.f;
+
+  DrumEngine<kTracks, 1> _engine;
+  std::array<SimpleBD, 3> _bd;
+  std::array<SimpleSD, 3> _sd;
+  std::array<SimpleHH, 2> _hh;
+  std::array<float, kMaxBlockSize> _left;
+  std::array<float, kMaxBlockSize> _right;
+};
+
+};
@@ -0,0 +1,205 @@
+#pragma once
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "DaisyDuino.h"
+
+namespace synthux {
+
+/**
+ * @brief
+ * The six square oscillators of the 808 hat, rendered kChunk
+ * samples at a time: one oscillator over the whole chunk, then the
+ * next, summing sign bits into a buffer. Every MetalHat reads the
+ * same bank through its own read position, so the oscillators run
+ * once per sample however many hats are ringing.
+ */
+class MetalBank {
+public:
+  MetalBank():
+  _rendered { 0 }
+  {
+    for (auto& p: _phase) p = 0;
+    for (auto& i: _increment) i = 0;
+  }
+
+  // Base frequency, the ratios are fixed.
+  void SetFreq(const float freq, const float sample_rate) {
+    static constexpr float kRatios[kOscCount] = { 1.f, 1.304f, 1.466f, 1.787f, 1.932f, 2.536f };
+    for (size_t k = 0; k < kOscCount; k++) {
+      auto f = fminf(freq * kRatios[k] / sample_rate, .499f);
+      _increment[k] = static_cast<uint32_t>(f * 4294967296.f);
+    }
+  }
+
+  // A position that fell behind the buffer, or a new
+  // one, jumps to the next fresh sample.
+  float Read(uint32_t& pos) {
+    if (static_cast<int32_t>(_rendered - pos) > static_cast<int32_t>(kSize)) pos = _rendered;
+    while (static_cast<int32_t>(pos - _rendered) >= 0) _render();
+    return _buffer[pos++ & kMask];
+  }
+
+  uint32_t Now() const { return _rendered; }
+
+private:
+  static constexpr size_t kOscCount = 6;
+  static constexpr size_t kChunk = 16;
+  // Room for two engine blocks
+  static constexpr size_t kSize = 256;
+  static constexpr size_t kMask = kSize - 1;
+
+  void _render() {
+    uint32_t sum[kChunk] = { 0 };
+    for (size_t k = 0; k < kOscCount; k++) {
+      auto phase = _phase[k];
+      auto increment = _increment[k];
+      for (size_t i = 0; i < kChunk; i++) {
+        phase += increment;
+        sum[i] += phase >> 31;
+      }
+      _phase[k] = phase;
+    }
+    auto out = _buffer + (_rendered & kMask);
+    for (size_t i = 0; i < kChunk; i++) out[i] = .33f * sum[i] - 1.f;
+    _rendered += kChunk;
+  }
+
+  float _buffer[kSize];
+  uint32_t _phase[kOscCount];
+  uint32_t _increment[kOscCount];
+  uint32_t _rendered;
+};
+
+/**
+ * @brief
+ * 808 style hat after DaisySP's HiHat<SquareNoise>, with the same
+ * parameters and response. The filter and envelope coefficients
+ * are worked out in the setters rather than every sample, the
+ * metallic ring comes from the shared MetalBank, and once the
+ * envelope has died away Process() returns 0 straight away.
+ */
+class MetalHat {
+public:
+  MetalHat():
+  _sample_rate    { 48000.f },
+  _tone           { .5f },
+  _decay          { .2f },
+  _noisiness      { .64f },
+  _accent         { .8f },
+  _envelope       { 0.f },
+  _envelope_decay { 0.f },
+  _cut_decay      { 0.f },
+  _noise_f        { 0.f },
+  _noise_clock    { 0.f },
+  _noise_sample   { 0.f },
+  _noise_seed     { 1 },
+  _pos            { 0 },
+  _is_idle        { true }
+  {}
+
+  void Init(const float sample_rate) {
+    _sample_rate = sample_rate;
+    _bank.SetFreq(2.f * kFreq, sample_rate);
+    _bpf.Init(sample_rate);
+    _hpf.Init(sample_rate);
+    _hpf.SetRes(.5f);
+    SetTone(.5f);
+    SetDecay(.2f);
+    SetNoisiness(.8f);
+    SetAccent(.8f);
+  }
+
+  void SetTone(const float value) {
+    _tone = fclamp(value, 0.f, 1.f);
+    auto cutoff = fclamp(150.f * _semitones(_tone * 72.f), 0.f, 16000.f);
+    _bpf.SetFreq(cutoff);
+    // 3 + 6 * tone, clamped by Svf
+    _bpf.SetRes(1.f);
+    _hpf.SetFreq(cutoff);
+  }
+
+  // Same range as DaisySP: 0 short ... 1 long, more rings on.
+  void SetDecay(const float value) {
+    _decay = fmaxf(value, 0.f) * 1.7f - 1.2f;
+    _envelope_decay = 1.f - .003f * _semitones(-_decay * 84.f);
+    _cut_decay = 1.f - .0025f * _semitones(-_decay * 36.f);
+  }
+
+  void SetNoisiness(const float value) {
+    _noisiness = fclamp(value, 0.f, 1.f);
+    _noisiness *= _noisiness;
+    _noise_f = fclamp(kFreq / _sample_rate * (16.f + 16.f * (1.f - _noisiness)), 0.f, .5f);
+  }
+
+  void SetAccent(const float value) {
+    _accent = fclamp(value, 0.f, 1.f);
+  }
+
+  float Process(const bool trigger) {
+    if (trigger) {
+      _envelope = (1.5f + .5f * (1.f - _decay)) * (.3f + .7f * _accent);
+      if (_is_idle) _pos = _bank.Now();
+      _is_idle = false;
+    }
+    if (_is_idle) return 0.f;
+
+    _bpf.Process(_bank.Read(_pos));
+    auto out = _bpf.Band();
+
+    // Clocked noise on top of the ring
+    _noise_clock += _noise_f;
+    if (_noise_clock >= 1.f) {
+      _noise_clock -= 1.f;
+      _noise_seed = _noise_seed * 1664525u + 1013904223u;
+      _noise_sample = static_cast<float>(_noise_seed >> 8) * (1.f / 16777216.f) - .5f;
+    }
+    out += _noisiness * (_noise_sample - out);
+
+    _envelope *= _envelope > .5f ? _envelope_decay : _cut_decay;
+    _hpf.Process(out * _envelope);
+
+    if (_envelope < kSilence) _sleep();
+    return _hpf.High();
+  }
+
+private:
+  static constexpr float kFreq = 3000.f;
+  // -100 dB
+  static constexpr float kSilence = 1e-5f;
+
+  static float _semitones(const float value) {
+    return powf(2.f, value * (1.f / 12.f));
+  }
+
+  void _sleep() {
+    _is_idle = true;
+    _envelope = 0.f;
+    _bpf.Init(_sample_rate);
+    _hpf.Init(_sample_rate);
+    _hpf.SetRes(.5f);
+    SetTone(_tone);
+  }
+
+  inline static MetalBank _bank;
+
+  Svf _bpf;
+  Svf _hpf;
+  float _sample_rate;
+  float _tone;
+  float _decay;
+  float _noisiness;
+  float _accent;
+  float _envelope;
+  float _envelope_decay;
+  float _cut_decay;
+  float _noise_f;
+  float _noise_clock;
+  float _noise_sample;
+  uint32_t _noise_seed;
+  uint32_t _pos;
+  bool _is_idle;
+};
+
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <array>
 #include <math.h>
+#include <stdint.h>
 
 namespace synthux {
 
@@ -14,6 +15,12 @@ struct LUTSin {
   }
 };
 
+/**
+ * @brief
+ * Table sine with a 32 bit phase accumulator. The top bits of
+ * the phase index the table, the bits below give the
+ * interpolation fraction, and wrapping is the integer overflow.
+ */
 class LUTSinOsc {
 public:
     LUTSinOsc():
@@ -26,15 +33,16 @@ public:
     ~LUTSinOsc() {}
 
     void Init(float sample_rate) {
-      _freq_kof = static_cast<float>(kSize) / sample_rate;
+      _freq_kof = kPhaseRange / sample_rate;
     }
 
     void SetFreq(const float freq) {
-        _phase_increment = freq * _freq_kof;
+        _phase_increment = static_cast<uint32_t>(static_cast<int64_t>(freq * _freq_kof));
     }
 
+    // Offset in cycles, wraps outside 0...1
     void SetPhaseOffset(const float value) {
-      _phase_offset = static_cast<float>(kSize) * value;
+      _phase_offset = static_cast<uint32_t>(static_cast<int64_t>((value - floorf(value)) * kPhaseRange));
     }
 
     void Reset() {
@@ -42,20 +50,17 @@ public:
     }
 
     float Process() {
-      auto size = static_cast<float>(kSize);
-      auto phase = _wrap_min_max(_phase + _phase_offset, 0.f, size);
+      auto phase = _phase + _phase_offset;
 
       //Do linear interpollation a + k * (b - a)
-      auto _int_phase = static_cast<size_t>(phase);
-      auto _frac_phase = phase - _int_phase;
-      auto _next_phase = _int_phase + 1;
-      while (_next_phase >= kSize) _next_phase -= kSize;
-      auto sample = _lut.table[_int_phase] + _frac_phase * (_lut.table[_next_phase] - _lut.table[_int_phase]);
+      auto int_phase = phase >> kFracBits;
+      auto frac_phase = static_cast<float>(phase & kFracMask) * kFracScale;
+      auto next_phase = (int_phase + 1) & (kSize - 1);
+      auto sample = _lut.table[int_phase] + frac_phase * (_lut.table[next_phase] - _lut.table[int_phase]);
 
-      //Advance phase
+      //Advance phase, wraps by overflow
       _phase += _phase_increment;
-      while (_phase >= size) _phase -= size;
-      
+
       return sample;
     }
 
@@ -65,20 +70,19 @@ private:
     LUTSinOsc& operator=(const LUTSinOsc &other) = delete;
     LUTSinOsc& operator=(LUTSinOsc &&other) = delete;
 
-    // https://stackoverflow.com/questions/4633177/how-to-wrap-a-float-to-the-interval-pi-pi
-    float _wrap_max(const float x, const float max) {
-      return fmodf(max + fmodf(x, max), max);
-    }
-    float _wrap_min_max(const float x, const float min, const float max) {
-      return min + _wrap_max(x - min, max - min);
-    }
-
     float _freq_kof;
-    float _phase;
-    float _phase_increment;
-    float _phase_offset;
+    uint32_t _phase;
+    uint32_t _phase_increment;
+    uint32_t _phase_offset;
 
     static constexpr size_t kSize = 512;
+    static constexpr uint32_t kIndexBits = 9;
+    static constexpr uint32_t kFracBits = 32 - kIndexBits;
+    static constexpr uint32_t kFracMask = (1u << kFracBits) - 1;
+    static constexpr float kFracScale = 1.f / static_cast<float>(1u << kFracBits);
+    static constexpr float kPhaseRange = 4294967296.f; // 2^32
+    static_assert((1u << kIndexBits) == kSize, "Table size must be 2^kIndexBits");
+
     static constexpr LUTSin<kSize> _lut = LUTSin<kSize>();
 };
 
@@ -0,0 +1,118 @@
+#pragma once
+#include <math.h>
+#include <stdint.h>
+
+#include "DaisyDuino.h"
+#include "clkin.h"
+
+namespace synthux {
+
+/**
+ * @brief
+ * Feeds ClockPll synthetic 4 ppqn clocks with timing noise and
+ * prints the RMS phase error over Serial: of the raw edges and of
+ * the PLL's filtered edges, against the true ones, in us.
+ * Device only: enable PLL_BENCH in TouchDrumMachine.ino and it
+ * runs once from setup().
+ */
+class PllBench {
+public:
+  PllBench():
+  _seed { 1 }
+  {}
+
+  void Run() {
+    Serial.println("BENCH: pll, raw lag, raw jitter, pll lag, pll jitter (us), tempo % err");
+    // The old loop() polling: edges land up to 4 ms late
+    _print("polled 120", _run(120.f, 120.f, 4000.f, 0.f));
+    // Interrupt latency only
+    _print("isr 120", _run(120.f, 120.f, 20.f, 0.f));
+    // Sloppy clock source with Gaussian-ish jitter
+    _print("jitter 120", _run(120.f, 120.f, 20.f, 1000.f));
+    // Tempo drifting under the PLL
+    _print("drift 100-140", _run(100.f, 140.f, 20.f, 1000.f));
+    // Tempo jump, relock
+    _print("jump 90-150", _run(90.f, 150.f, 20.f, 1000.f, true));
+  }
+
+private:
+  static constexpr uint32_t kPulses = 512;
+  static constexpr uint32_t kSettle = 32;
+  static constexpr float kPPQN = 4.f;
+
+  struct Stat {
+    float sum = 0.f;
+    float sum_sq = 0.f;
+    void Add(const float value) { sum += value; sum_sq += value * value; }
+    float Mean(const uint32_t count) const { return sum / count; }
+    float Dev(const uint32_t count) const {
+      auto mean = Mean(count);
+      return sqrtf(fmaxf(sum_sq / count - mean * mean, 0.f));
+    }
+  };
+
+  struct Result {
+    float raw_lag;
+    float raw_jitter;
+    float pll_lag;
+    float pll_jitter;
+    float tempo;
+  };
+
+  // late_us - uniform 0...late_us lag of the capture,
+  // jitter_us - zero mean noise of the source.
+  Result _run(const float bpm_from, const float bpm_to, const float late_us, const float jitter_us, const bool jump = false) {
+    ClockPll pll;
+    auto t = 1000.f;
+    Stat raw;
+    Stat filtered;
+    auto tempo = 0.f;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < kPulses; i++) {
+      auto pos = static_cast<float>(i) / kPulses;
+      auto bpm = jump ? (pos < .5f ? bpm_from : bpm_to) : bpm_from + (bpm_to - bpm_from) * pos;
+      auto period = 60e6f / (bpm * kPPQN);
+      t += period;
+      auto noise = jitter_us * (_rand() + _rand() - 1.f);
+      auto edge = t + noise + late_us * _rand();
+      auto stamp = static_cast<uint32_t>(edge);
+      if (!pll.Process(stamp) || !pll.IsLocked()) continue;
+      // Skip the lock-in, and after the jump
+      if (i < kSettle || (jump && i >= kPulses / 2 && i < kPulses / 2 + kSettle)) continue;
+      auto raw_err = edge - t;
+      auto pll_err = static_cast<float>(static_cast<int32_t>(pll.Edge() - static_cast<uint32_t>(t)));
+      raw.Add(raw_err);
+      filtered.Add(pll_err);
+      auto tempo_err = (pll.Period() - period) / period;
+      tempo += tempo_err * tempo_err;
+      count++;
+    }
+    if (count == 0) return {};
+    return { raw.Mean(count), raw.Dev(count), filtered.Mean(count), filtered.Dev(count), 100.f * sqrtf(tempo / count) };
+  }
+
+  // 0...1
+  float _rand() {
+    _seed = _seed * 1664525u + 1013904223u;
+    return static_cast<float>(_seed >> 8) * (1.f / 16777216.f);
+  }
+
+  void _print(const char* name, const Result& r) {
+    Serial.print("BENCH: ");
+    Serial.print(name);
+    Serial.print(", ");
+    Serial.print(r.raw_lag);
+    Serial.print(", ");
+    Serial.print(r.raw_jitter);
+    Serial.print(", ");
+    Serial.print(r.pll_lag);
+    Serial.print(", ");
+    Serial.print(r.pll_jitter);
+    Serial.print(", ");
+    Serial.println(r.tempo);
+  }
+
+  uint32_t _seed;
+};
+
+};
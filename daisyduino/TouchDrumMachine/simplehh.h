@@ -1,13 +1,21 @@
 #pragma once;
 
 #include "DaisyDuino.h"
+#include "hihat.h"
 
 namespace synthux {
-  class SimpleHH {
+  enum class HatType {
+    closed,
+    open
+  };
+
+  // Both types ring from the same MetalBank.
+  template<HatType type = HatType::closed>
+  class HatVoice {
     public:
       void Init(float sample_rate) {
         _hh.Init(sample_rate);
-        _hh.SetDecay(0.7);
+        _hh.SetDecay(type == HatType::open ? 1.1 : 0.7);
         _hh.SetTone(0.8);
         _hh.SetNoisiness(0.7);
       }
@@ -17,12 +25,16 @@ namespace synthux {
       }
 
       void SetTone(float value) {
-        _hh.SetDecay(0.5 + 0.5 * value);
+        if (type == HatType::open) _hh.SetDecay(1.0 + 0.3 * value);
+        else _hh.SetDecay(0.5 + 0.5 * value);
         _hh.SetTone(0.5 + 0.5 * (1 - value));
         _hh.SetNoisiness(0.3 + 0.5 * (1 - value));
       }
 
     private:
-      HiHat<> _hh;
+      MetalHat _hh;
   };
-};
\ No newline at end of file
+
+  using SimpleHH = HatVoice<HatType::closed>;
+  using OpenHH = HatVoice<HatType::open>;
+};
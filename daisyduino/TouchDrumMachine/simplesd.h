@@ -1,6 +1,8 @@
 #pragma once
 
 #include "DaisyDuino.h"
+#include "shaper.h"
+#include "wavetable.h"
 
 namespace synthux {
 
@@ -13,7 +15,7 @@ public:
     _env.SetTime(ADSR_SEG_ATTACK, .0);
     _env.SetTime(ADSR_SEG_RELEASE, .03);
     _osc.Init(sample_rate);
-    _osc.SetWaveform(Oscillator::WAVE_TRI);
+    _osc.SetWaveform(Waveform::tri);
     _drv.SetDrive(0.5);
   }
 
@@ -35,8 +37,8 @@ public:
 private:
   Adsr _env;
   WhiteNoise _noise;
-  Oscillator _osc;
-  Overdrive _drv;
+  WaveOsc _osc;
+  Shaper<2> _drv;
   float _noise_kof = 1.0;
 };
 
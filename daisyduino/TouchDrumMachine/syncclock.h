@@ -1,8 +1,13 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <stdint.h>
 
+#include "clkin.h"
+#include "midiclk.h"
+#include "transport.h"
+
 namespace synthux {
 
 static constexpr float kBPMMin = 40.f;
@@ -22,29 +27,32 @@ public:
       _on_tick             { nullptr },
       _is_running          { false },
       _is_about_to_run     { false },
-      _tr_time             { 0 },
+      _block_size          { 0 },
       _ticks_per_clock     { ppqn / ext_ppqn },
       _ticks               { 0 },
-      _fticks              { 0 },
       _ticks_at_last_clock { 0 },
       _tempo_ticks         { 0 },
       _hold                { false },
       _resync              { false },
       _manual_tempo        { 120 },
       _raw_manual_tempo    { 120 },
-      _tempo_mks           { 500000 },
-      _last_state          { 1 } 
+      _last_state          { 1 },
+      _tick_offset         { 0 },
+      _midi_out            { nullptr },
+      _reset_pending       { false }
       {}
     
     ~SyncClock() = default;
 
     void Init(float sample_rate, float buffer_size) {
-        auto interval = 1e6 * buffer_size / sample_rate;
-        _tr_time = ppqn * interval;
+        _transport.Init(static_cast<uint32_t>(sample_rate));
+        _transport.SetTempo(_manual_tempo);
+        _block_size = static_cast<uint32_t>(buffer_size);
     }
 
     // Called by internal interrupt timer (audio callback in this implementation).
     void Tick() {
+        apply_reset();
         if (!_is_running) return;
         emit_ticks();
     }
@@ -53,6 +61,15 @@ public:
       _on_tick = on_tick;
     }
 
+    // Optional, gets every tick and the start/stop.
+    void SetMidiOut(MidiClockOut<ppqn>* midi_out) {
+      _midi_out = midi_out;
+    }
+
+    // Sample in the current block of the tick being
+    // emitted, valid inside the on tick callback.
+    uint32_t TickOffset() { return _tick_offset; }
+
     /*
     Read external clock pin
     */
@@ -63,7 +80,29 @@ public:
         _last_state = state;
     }
     
-    float Tempo() { return 60000000.f / _tempo_mks; }
+    /*
+    External clock edge captured by ClockIn, in micros().
+    Call from the audio callback before Tick(), with the current
+    time. The PLL smooths the edge jitter out and sets the tempo,
+    the timeline is resynced to the filtered edge and the ticks
+    due since then go out with the next Tick().
+    */
+    void Sync(uint32_t edge_us, uint32_t now_us) {
+        apply_reset();
+        if (!external_clock()) return;
+        if (!_pll.Process(edge_us)) return;
+        external_clock_tick();
+        if (!_pll.IsLocked() || !_is_running) return;
+        _transport.SetBeatLength(_pll.Period() * ext_ppqn);
+        auto elapsed = static_cast<int32_t>(now_us - _pll.Edge());
+        if (elapsed > 0 && elapsed < _pll.Period()) _transport.Resync(elapsed);
+    }
+
+    float Tempo() { return _transport.Tempo(); }
+
+    // Timeline position since Run().
+    Position CurrentPosition() { return _transport.At(_ticks); }
+
     /*
     Setting tempo from internal control. 
     Has no effect in case of syncing to extrnal clock.
@@ -73,7 +112,7 @@ public:
         _raw_manual_tempo = norm_value;
         const auto clock_off_offset = 10;
         _manual_tempo = (kBPMRange - clock_off_offset) * norm_value + kBPMMin - clock_off_offset;
-        _tempo_mks = tempo_mks(_manual_tempo);
+        _transport.SetTempo(_manual_tempo);
         if (external_clock()) {
             if (_is_running) {
                 _is_running = false;
@@ -83,7 +122,7 @@ public:
                 _is_running = true;
                 _is_about_to_run = false;
             }
-            reset();
+            request_reset();
         }
     }
 
@@ -94,13 +133,15 @@ public:
     see clock_in_tick() below.
     */
     void Run() {
+      if (_midi_out != nullptr) _midi_out->Start();
       if (external_clock()) _is_about_to_run = true;
       else _is_running = true;
     }
 
     void Stop() {
+      if (_midi_out != nullptr) _midi_out->Stop();
       _is_running = false;
-      reset();
+      request_reset();
     }
     bool IsRunning() { return _is_running; };
 
@@ -132,23 +173,22 @@ private:
     This method generates internal ticks and also synchronises to the external clock.
     So it's called both from internal interrupt timer (audio callback in this implementation) and upon external clock tick reception.
     nticks - integer count of internal ticks
-    _fticks - fractional count of internal ticks
     _tempo_ticks - integer ticks count since last external clock
-    _tempo_mks - tempo in microseconds / beat (quarter note)
+    _transport - tempo, and the sub-tick phase as an exact fraction of a tick
     _resync - flag to resync to external clock. Is set to true once external clock tick is received.
     _hold - flag to stop advancing internal timeline if the number of internal ticks exceeded expected count of internal ticks per extrnal tick
-    _tr_time - internal resolution (ppqn) multiplied by interrupt interval.
+    _block_size - samples per interrupt (audio block).
     */
     void emit_ticks() {
         size_t nticks = 0;
+        size_t advanced = 0;
 
         //If we generated more internal ticks per extrnal tick as expected,
         //we don't advance internal "timeline", but only accumulate _tempo_ticks
         //in order to calculate and correct the tempo.
         //This flag is set to false upon reception of the external tick.
         if (_hold) {
-            nticks = (_fticks + _tr_time) / _tempo_mks;
-            _fticks += _tr_time - (nticks * _tempo_mks);
+            nticks = _transport.Advance(_block_size);
             _tempo_ticks += nticks;
             return;
         }
@@ -157,17 +197,20 @@ private:
         //we do resync, i.e. align inernal timeline with the external one
         //and adjust tempo.
         if (_resync) {
-            _fticks = 0;
+            //Catching up, the ticks are due now.
+            _transport.Resync();
             nticks = _ticks_per_clock - (_ticks - _ticks_at_last_clock);
             _ticks_at_last_clock = _ticks + nticks;
-            _tempo_mks -= ((int32_t)_ticks_per_clock - (int32_t)_tempo_ticks) * (int32_t)_tempo_mks / (int32_t)ppqn;
+            // Beat length scaled by (ppqn - missing) / ppqn
+            auto beat = (int64_t)ppqn - ((int64_t)_ticks_per_clock - (int64_t)_tempo_ticks);
+            if (beat > 0) _transport.SetMilliBPM((uint64_t)_transport.MilliBPM() * ppqn / beat);
             _tempo_ticks = 0;
             _resync = false;
         }
         //Regular mode. We generate internal ticks.
         else {
-            nticks = (_fticks + _tr_time) / _tempo_mks;
-            _fticks += _tr_time - nticks * _tempo_mks;
+            nticks = _transport.Advance(_block_size);
+            advanced = nticks;
             if (external_clock()) {
                 _tempo_ticks += nticks;
                 //If there are more internal ticks per the external tick than 
@@ -184,13 +227,30 @@ private:
         _ticks += nticks;
 
         //Advance timeline
-        if (_on_tick != nullptr) {
-          for (size_t i = 0; i < nticks; i++) _on_tick();
+        for (size_t i = 0; i < nticks; i++) {
+          _tick_offset = advanced > 0 ? _transport.TickOffset(i, advanced) : 0;
+          if (_midi_out != nullptr) _midi_out->Tick(_tick_offset);
+          if (_on_tick != nullptr) _on_tick();
         }
     }
     
+    /*
+    SetTempo() and Stop() run in loop(), while the callback is
+    using the PLL, the timeline and the tick counts. They only
+    raise a flag, the callback does the reset before it touches
+    any of them again.
+    */
+    void request_reset() {
+        _reset_pending.store(true, std::memory_order_release);
+    }
+
+    void apply_reset() {
+        if (_reset_pending.exchange(false, std::memory_order_acq_rel)) reset();
+    }
+
     void reset() {
-         _fticks = 0;
+        _pll.Reset();
+        _transport.Reset();
         _ticks = 0;
         _ticks_at_last_clock = 0;
         _tempo_ticks = 0;
@@ -198,29 +258,29 @@ private:
         _resync = false;
     }
     
-    size_t tempo_mks(const float tempo) {
-        return static_cast<size_t>(60.f * 1e6 / tempo);
-    }
-
     void(*_on_tick)();
 
     bool _is_running;
     bool _is_about_to_run;
 
-    size_t _tr_time;
+    uint32_t _block_size;
     size_t _ticks_per_clock;
-    size_t _ticks;
-    size_t _fticks;
-    size_t _ticks_at_last_clock;
+    uint64_t _ticks;
+    uint64_t _ticks_at_last_clock;
     size_t _tempo_ticks;
     bool _hold;
     bool _resync;
 
     float _manual_tempo;
     float _raw_manual_tempo;
-    size_t _tempo_mks;
 
     int _last_state;
+    uint32_t _tick_offset;
+
+    MidiClockOut<ppqn>* _midi_out;
+    ClockPll _pll;
+    Transport<ppqn> _transport;
+    std::atomic<bool> _reset_pending;
 };
 
 };
@@ -1,89 +1,200 @@
 #pragma once
 #include <inttypes.h>
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <math.h>
 
 namespace synthux {
+
+/**
+ * @brief
+ * Step sequencer track. Up to kMaxSteps steps (kMaxBars bars of
+ * kStepsPerBar), one bit per step, with per-step parameter locks
+ * (tone, velocity, nudge) stored as bytes side by side.
+ * The nudge is signed: an early step goes out on the tick before
+ * its onset, with a delay that lands it ahead of the grid.
+ * The length can be set per track, so tracks of different
+ * lengths run as polymeters.
+ * Tick() runs in the audio callback and owns the pattern;
+ * HitStroke() from loop() only hands the stroke over.
+ */
 class Track {
 public:
+    static constexpr uint32_t kStepsPerBar = 64;
+    static constexpr uint32_t kMaxBars = 8;
+    static constexpr uint32_t kMaxSteps = kStepsPerBar * kMaxBars;
+    static constexpr float kNudgeUnit = .0005f; // s
+    // Of a tick, i.e. under half a step either way,
+    // so nudged neighbours never swap or collide
+    static constexpr float kMaxNudge = .9f;
+
     Track():
     _counter        { 0 },
     _slot           { 0 },
-    _last_hit_slot  { 0xff },
-    _trigger        { nullptr },
-    _is_clearing    { false }
+    _length         { kDefaultLength },
+    _last_hit_slot  { kNoSlot },
+    _is_early       { false },
+    _is_recording   { false },
+    _is_clearing    { false },
+    _stroke         { 0 }
     {
-      _pattern.fill(0);
-      _automation.fill(0.5);
+      Clear();
     }
     ~Track() {};
 
     bool Tick() {
-        // Remember current slot
-        auto slot = _slot;
-        // The slot is adwanced every two ticks, 
+        // A stroke played since the last tick lands on this slot.
+        auto stroke = _stroke.exchange(0, std::memory_order_acquire);
+        if (stroke != 0) _record(stroke);
+
+        _is_early = false;
+        // The slot is adwanced every two ticks,
         // and one tick before actual onset position.
-        if (++_counter == 2) {
+        if (++_counter == kTicksPerSlot) {
             _counter = 0;
             // Advance and wrap the current slot.
-            if (++_slot == _pattern.size()) _slot = 0;
+            if (++_slot == _length) _slot = 0;
             // Clear slot if in clearing mode.
             if (_is_clearing) _clear(_slot);
+            // A step nudged early goes out now, ahead of its onset.
+            _is_early = _is_set(_slot) && _nudge[_slot] < 0;
+            if (_is_early) _last_hit_slot = _slot;
+            return _is_early;
         }
-        
-        // If the slot was not advanced 
+
+        // If the slot was not advanced
         // it means we're at the onset possion,
         // and if this position is not empty
         // in the pattern array - the drum should be triggered.
-        // A check against _last_hit_slot is 
-        // to prevent double triggering during recording.
-        auto should_trigger = (slot == _slot && _pattern[_slot] && _slot != _last_hit_slot);
+        // A check against _last_hit_slot is to prevent double
+        // triggering during recording or after an early hit.
+        auto should_trigger = (_is_set(_slot) && _slot != _last_hit_slot);
         // Reset last hit slot.
-        _last_hit_slot = 0xff;
-        
+        _last_hit_slot = kNoSlot;
+
         return should_trigger;
     }
 
+    // Parameter locks of the current slot, 0...1
+
     float AutomationValue() {
-      return _automation[_slot];
+      return _tone[_slot] * kByteRecip;
+    }
+
+    float Velocity() {
+      return _velocity[_slot] * kByteRecip;
     }
 
-    void HitStroke(float automation_value) {
-      if (_is_recording) {
-        _pattern[_slot] = true;
-        _automation[_slot] = automation_value;
-        _last_hit_slot = _slot;
-      }
+    // The nudge lock, seconds early (< 0) or late.
+    float Nudge() {
+      return _nudge[_slot] * kNudgeUnit;
     }
 
-    void SetRecording(bool value) { 
-      _is_recording = value; 
+    // When the hit from the last Tick() lands, seconds after it.
+    // tick_length - seconds between ticks at the current tempo,
+    // the nudge is clamped to kMaxNudge of it.
+    float Delay(const float tick_length) {
+      auto limit = kMaxNudge * tick_length;
+      auto nudge = std::clamp(Nudge(), -limit, limit);
+      return _is_early ? tick_length + nudge : std::max(nudge, 0.f);
+    }
+
+    // From loop(): recorded into the current slot on the next
+    // Tick(). A second stroke before that tick replaces the first.
+    void HitStroke(float automation_value, float velocity = 1.f) {
+      if (!_is_recording) return;
+      _stroke.store(kStrokeFlag
+        | static_cast<uint32_t>(_to_byte(velocity)) << 8
+        | _to_byte(automation_value), std::memory_order_release);
+    }
+
+    // Writes a step and its locks directly, e.g. from a preset.
+    void SetStep(uint32_t step, float tone, float velocity = 1.f, float nudge = 0.f) {
+      if (step >= kMaxSteps) return;
+      _pattern[step >> kWordShift] |= _bit(step);
+      _tone[step] = _to_byte(tone);
+      _velocity[step] = _to_byte(velocity);
+      _nudge[step] = static_cast<int8_t>(lroundf(std::clamp(nudge / kNudgeUnit, -127.f, 127.f)));
+    }
+
+    void SetRecording(bool value) {
+      _is_recording = value;
     }
 
     void SetClearing(bool value) {
       _is_clearing = value;
     }
 
+    // Steps before the track wraps, 1...kMaxSteps.
+    void SetLength(uint32_t length) {
+      _length = std::clamp(length, static_cast<uint32_t>(1), kMaxSteps);
+      if (_slot >= _length) _slot = 0;
+    }
+
+    uint32_t Length() {
+      return _length;
+    }
+
+    void Clear() {
+      _pattern.fill(0);
+      _tone.fill(kToneDefault);
+      _velocity.fill(kVelocityDefault);
+      _nudge.fill(0);
+    }
+
     void Reset() {
       _slot = 0;
       _counter = 0;
     }
 
 private:
-    void _clear(uint32_t slot) {
-        _pattern[slot] = false;
+    static constexpr uint32_t kTicksPerSlot = 2;
+    static constexpr uint32_t kDefaultLength = 16;
+    static constexpr uint32_t kWordShift = 6; // 64 steps per word
+    static constexpr uint32_t kNoSlot = 0xffff;
+    static constexpr uint8_t kToneDefault = 128;
+    static constexpr uint8_t kVelocityDefault = 255;
+    static constexpr float kByteMax = 255.f;
+    static constexpr float kByteRecip = 1.f / 255.f;
+    // Tone in the low byte, velocity in the next one.
+    static constexpr uint32_t kStrokeFlag = 1 << 16;
+
+    static uint64_t _bit(uint32_t slot) {
+      return static_cast<uint64_t>(1) << (slot & (kStepsPerBar - 1));
     }
-    
-    void(*_trigger)();
 
-    static constexpr uint32_t kTicksPerSlot = 2;
-    static constexpr uint32_t kPatternLength = 16;
+    static uint8_t _to_byte(float value) {
+      return static_cast<uint8_t>(std::clamp(value, 0.f, 1.f) * kByteMax + .5f);
+    }
+
+    bool _is_set(uint32_t slot) {
+      return _pattern[slot >> kWordShift] & _bit(slot);
+    }
+
+    void _record(const uint32_t stroke) {
+      _pattern[_slot >> kWordShift] |= _bit(_slot);
+      _tone[_slot] = stroke & 0xff;
+      _velocity[_slot] = (stroke >> 8) & 0xff;
+      _nudge[_slot] = 0;
+      _last_hit_slot = _slot;
+    }
+
+    void _clear(uint32_t slot) {
+      _pattern[slot >> kWordShift] &= ~_bit(slot);
+    }
 
-    std::array<bool, kPatternLength> _pattern;
-    std::array<float, kPatternLength> _automation;
+    std::array<uint64_t, kMaxBars> _pattern;
+    std::array<uint8_t, kMaxSteps> _tone;
+    std::array<uint8_t, kMaxSteps> _velocity;
+    std::array<int8_t, kMaxSteps> _nudge;
     uint32_t _counter;
     uint32_t _slot;
+    uint32_t _length;
     uint32_t _last_hit_slot;
+    bool _is_early;
     bool _is_recording;
     bool _is_clearing;
+    std::atomic<uint32_t> _stroke;
 };
 };
@@ -0,0 +1,207 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace synthux {
+
+enum class Waveform {
+  sine,
+  tri,
+  saw,
+  square
+};
+
+/**
+ * @brief
+ * Band-limited tables for WaveOsc, one level per octave.
+ * Level 0 holds kMaxHarmonics harmonics in a 4x oversampled
+ * table, each next level half the harmonics in half the size.
+ * Built by the compiler from a sine table, stored as int16 in
+ * flash. Sine only has level 0.
+ */
+namespace mip {
+
+static constexpr size_t kLevels = 8;
+static constexpr size_t kMaxHarmonics = 128;
+static constexpr uint32_t kTopBits = 9; // level 0: 512 samples
+static constexpr uint32_t kMinBits = 5;
+
+constexpr uint32_t Bits(const size_t level) {
+  return std::max(kTopBits - static_cast<uint32_t>(level), kMinBits);
+}
+
+// Each level carries a guard sample, so the
+// interpolation never has to wrap.
+constexpr size_t Offset(const size_t level) {
+  size_t offset = 0;
+  for (size_t l = 0; l < level; l++) offset += (1u << Bits(l)) + 1;
+  return offset;
+}
+
+static constexpr float kScale = 32767.f;
+
+template<Waveform waveform>
+struct Table {
+  static constexpr size_t kLevelCount = waveform == Waveform::sine ? 1 : kLevels;
+  std::array<int16_t, Offset(kLevelCount)> data;
+
+  constexpr Table(): data() {
+    constexpr size_t sin_size = 1u << kTopBits;
+    std::array<float, sin_size> sin_table {};
+    for (size_t i = 0; i < sin_size; i++) {
+      sin_table[i] = sinf(2.f * static_cast<float>(M_PI) * i / sin_size);
+    }
+
+    for (size_t l = 0; l < kLevelCount; l++) {
+      auto size = 1u << Bits(l);
+      auto step = sin_size / size;
+      auto harmonics = kMaxHarmonics >> l;
+      std::array<float, kMaxHarmonics + 1> amps {};
+      for (size_t k = 1; k <= harmonics; k++) amps[k] = _amp(k, harmonics);
+      for (size_t i = 0; i <= size; i++) {
+        auto value = 0.f;
+        for (size_t k = 1; k <= harmonics; k++) {
+          if (amps[k] != 0.f) value += amps[k] * sin_table[(k * i * step) % sin_size];
+        }
+        value = std::clamp(value * kScale, -kScale, kScale);
+        data[Offset(l) + i] = static_cast<int16_t>(value);
+      }
+    }
+  }
+
+private:
+  // Fourier series with Lanczos sigma against the Gibbs ripple.
+  static constexpr float _amp(const size_t k, const size_t harmonics) {
+    auto kf = static_cast<float>(k);
+    auto x = static_cast<float>(M_PI) * kf / (harmonics + 1);
+    auto sigma = sinf(x) / x;
+    switch (waveform) {
+      case Waveform::sine:
+        return k == 1 ? 1.f : 0.f;
+      case Waveform::tri:
+        if (k % 2 == 0) return 0.f;
+        return (k % 4 == 1 ? 1.f : -1.f) * 8.f / (static_cast<float>(M_PI * M_PI) * kf * kf) * sigma;
+      default: // rising saw
+        return -2.f / (static_cast<float>(M_PI) * kf) * sigma;
+    }
+  }
+};
+
+}
+
+/**
+ * @brief
+ * Mip-mapped wavetable oscillator. Stands in for
+ * daisysp::Oscillator: Init, SetWaveform, SetFreq, SetAmp,
+ * Reset, Process.
+ * The table level is picked in SetFreq() so no harmonic passes
+ * Nyquist. Per sample it's a 32 bit phase add and one linear
+ * interpolation (two for the square, which is a saw minus
+ * itself half a cycle later).
+ */
+class WaveOsc {
+public:
+  WaveOsc():
+  _freq_kof   { 0.f },
+  _amp        { 1.f },
+  _phase      { 0 },
+  _increment  { 0 },
+  _max_level  { mip::kLevels - 1 },
+  _waveform   { Waveform::sine },
+  _table      { kSin.data.data() }
+  {
+    _set_level(0);
+  }
+
+  void Init(const float sample_rate) {
+    _freq_kof = 4294967296.f / sample_rate;
+    _phase = 0;
+    _amp = 1.f;
+    SetWaveform(Waveform::sine);
+  }
+
+  void SetWaveform(const Waveform waveform) {
+    _waveform = waveform;
+    switch (waveform) {
+      case Waveform::sine:
+        _table = kSin.data.data();
+        _max_level = 0;
+        break;
+      case Waveform::tri:
+        _table = kTri.data.data();
+        _max_level = mip::kLevels - 1;
+        break;
+      default:
+        _table = kSaw.data.data();
+        _max_level = mip::kLevels - 1;
+        break;
+    }
+    _set_level(_level_for(_increment));
+  }
+
+  void SetFreq(const float freq) {
+    _increment = static_cast<uint32_t>(static_cast<int64_t>(fabsf(freq) * _freq_kof));
+    _set_level(_level_for(_increment));
+  }
+
+  void SetAmp(const float amp) {
+    _amp = amp;
+  }
+
+  void Reset() {
+    _phase = 0;
+  }
+
+  float Process() {
+    auto out = _read(_phase);
+    if (_waveform == Waveform::square) out -= _read(_phase + 0x80000000u);
+    _phase += _increment;
+    return out * _amp * (1.f / mip::kScale);
+  }
+
+private:
+  // Level 0 is fine up to kMaxHarmonics harmonics below
+  // Nyquist, i.e. increment <= 2^32 / (2 * kMaxHarmonics).
+  size_t _level_for(const uint32_t increment) const {
+    static constexpr uint32_t kLevel0Bits = 31 - 7; // log2(kMaxHarmonics) = 7
+    static_assert(mip::kMaxHarmonics == 1u << 7, "Update kLevel0Bits");
+    if (increment <= (1u << kLevel0Bits)) return 0;
+    auto bits = 32 - __builtin_clz(increment - 1);
+    return std::min(static_cast<size_t>(bits - kLevel0Bits), _max_level);
+  }
+
+  void _set_level(const size_t level) {
+    auto bits = mip::Bits(level);
+    _offset = mip::Offset(level);
+    _index_shift = 32 - bits;
+    _frac_shift = bits;
+  }
+
+  float _read(const uint32_t phase) const {
+    auto i = _offset + (phase >> _index_shift);
+    auto frac = static_cast<float>(phase << _frac_shift) * (1.f / 4294967296.f);
+    auto a = static_cast<float>(_table[i]);
+    auto b = static_cast<float>(_table[i + 1]);
+    return a + frac * (b - a);
+  }
+
+  static constexpr mip::Table<Waveform::sine> kSin = mip::Table<Waveform::sine>();
+  static constexpr mip::Table<Waveform::tri> kTri = mip::Table<Waveform::tri>();
+  static constexpr mip::Table<Waveform::saw> kSaw = mip::Table<Waveform::saw>();
+
+  float _freq_kof;
+  float _amp;
+  uint32_t _phase;
+  uint32_t _increment;
+  size_t _max_level;
+  size_t _offset;
+  uint32_t _index_shift;
+  uint32_t _frac_shift;
+  Waveform _waveform;
+  const int16_t* _table;
+};
+
+};
@@ -1,12 +1,19 @@
 // SYNTHUX ACADEMY /////////////////////////////////////////
 // SIMPLE FX BOX ///////////////////////////////////////////
 
+// Uncomment to count heap allocations and
+// blocking calls made in the audio callback.
+// #define RT_GUARD
+
 #include "simple-touch-daisy.h"
+#include "rtguard.h"
 #include "aknob.h"
 #include "echo.h"
 #include "softswitch.h"
 #include "xfade.h"
 #include "mvalue.h"
+#include "sentinel.h"
+#include "shaper.h"
 #include <array>
 
 using namespace synthux;
@@ -58,15 +65,27 @@ static const int switch_2_b = D(S10);
 static const uint32_t kBufferLengthSec = 5;
 static const uint32_t kSampleRate = 48000;
 static const size_t kBufferLenghtSamples = kBufferLengthSec * kSampleRate;
-static float DSY_SDRAM_BSS delay_buf0[kBufferLenghtSamples];
-static float DSY_SDRAM_BSS delay_buf1[kBufferLenghtSamples];
-static EchoDelay<kBufferLenghtSamples> dly[2];
+static StereoEchoDelay<kBufferLenghtSamples> dly;
+// Rounded up to a power of two, 2^18
+static float DSY_SDRAM_BSS delay_buf0[StereoEchoDelay<kBufferLenghtSamples>::kBufferSize];
+static float DSY_SDRAM_BSS delay_buf1[StereoEchoDelay<kBufferLenghtSamples>::kBufferSize];
 
 static ReverbSc verb;
+// Runs at the sample rate, read once per chunk
 static Oscillator lfo;
-static Overdrive drv[2];
+static float lfo_freq = .05f;
+static float sample_time = 1.f / 48000.f;
+static const uint8_t kDriveOversampling = 4;
+static Shaper<kDriveOversampling, 2> drv;
 static Decimator dcm[2];
 
+static Sentinel dly_sentinel("delay");
+static Sentinel verb_sentinel("reverb");
+static Sentinel master_sentinel("master");
+// ReverbSc::Init() clears every delay line at
+// once, so it runs from loop() with the reverb muted
+static DeferredReset verb_reset;
+
 ////////////////////////////////////////////////////////////
 ////////////////////////// TOUCH  //////////////////////////
 static synthux::simpletouch::Touch touch;
@@ -99,8 +118,7 @@ void OnTouch(uint16_t pad) {
   }
 
   if (drive) {
-    drv[0].SetDrive(drv_level);
-    drv[1].SetDrive(drv_level);
+    drv.SetDrive(drv_level);
     drv_on.SetOn(!(latch && drv_on.IsOn()));
   }
 
@@ -133,55 +151,116 @@ void OnRelease(uint16_t pad) {
 ///////////////////// AUDIO CALLBACK //////////////////////////
 float dly_mix;
 float dly_time;
-float dly_bypass;
-float dly_in[2];
-
+static const size_t kMaxBlockSize = 256;
+float dly_bypass[kMaxBlockSize];
+float dly_in_buf[2][kMaxBlockSize];
+float dly_out_buf[2][kMaxBlockSize];
+float* dly_in[2] = { dly_in_buf[0], dly_in_buf[1] };
+float* dly_out[2] = { dly_out_buf[0], dly_out_buf[1] };
+
+float verb_fb = .3f;
 float verb_send;
 float verb_bypass;
 float verb_in[2];
 float verb_out[2];
 
 float drv_mix;
+float drv_frame[2];
 float dcm_mix;
 
 float bus0;
 float bus1;
 
-void AudioCallback(float **in, float **out, size_t size) {
-  for (size_t i = 0; i < size; i++) {
-    auto t = dly_time + 0.25 * lfo.Process();
-    if(t < 0) {
-      t = 0;
-    }
-    dly[0].SetDelayTime(t);
-    dly[1].SetDelayTime(t);
+void ResetReverb() {
+  verb.Init(DAISY.get_samplerate());
+  verb.SetLpFreq(8000.f);
+  verb.SetFeedback(verb_fb);
+}
 
-    bus0 = in[0][i];
-    bus1 = in[1][i];
+// Up to kMaxBlockSize samples of the callback block.
+void Render(const float *in0, const float *in1, float *out0, float *out1, size_t size, bool is_verb_on) {
+  // Drive and crush into the delay send, the dry bus waits in out
+  for (size_t i = 0; i < size; i++) {
+    bus0 = in0[i];
+    bus1 = in1[i];
 
     drv_mix = drv_mix_values[drv_mix_index].Value();
     drv_fade.SetStage(drv_on.Process());
-    drv_fade.Process(bus0, bus1, drv[0].Process(bus0) * drv_mix, drv[1].Process(bus1) * drv_mix, bus0, bus1);
+    drv_frame[0] = bus0;
+    drv_frame[1] = bus1;
+    drv.Process(drv_frame);
+    drv_fade.Process(bus0, bus1, drv_frame[0] * drv_mix, drv_frame[1] * drv_mix, bus0, bus1);
 
     dcm_mix = dcm_mix_values[dcm_mix_index].Value();
     dcm_fade.SetStage(dcm_on.Process());
     dcm_fade.Process(bus0, bus1, dcm[0].Process(bus0) * dcm_mix, dcm[1].Process(bus1) * dcm_mix, bus0, bus1);
       
-    dly_bypass = dly_bypass_on.Process(true) * dly_mix;
-    dly_in[0] = bus0 * dly_bypass;
-    dly_in[1] = bus1 * dly_bypass;
-    dly_fade.SetStage(dly_bypass);
-    dly_fade.Process(bus0, bus1, dly[0].Process(dly_in[0]), dly[1].Process(dly_in[1]), bus0, bus1);
+    dly_bypass[i] = dly_bypass_on.Process(true) * dly_mix;
+    dly_in[0][i] = bus0 * dly_bypass[i];
+    dly_in[1][i] = bus1 * dly_bypass[i];
+    out0[i] = bus0;
+    out1[i] = bus1;
+  }
+
+  dly.ProcessBlock(dly_in, dly_out, size);
+
+  for (size_t i = 0; i < size; i++) {
+    bus0 = out0[i];
+    bus1 = out1[i];
+    dly_fade.SetStage(dly_bypass[i]);
+    dly_fade.Process(bus0, bus1,
+      dly_sentinel.Watch(dly_out[0][i]),
+      dly_sentinel.Watch(dly_out[1][i]),
+      bus0, bus1
+    );
 
     verb_bypass = verb_bypass_on.Process(true) * verb_mix.Value();
     verb_in[0] = bus0 * verb_bypass * verb_send;
     verb_in[1] = bus1 * verb_bypass * verb_send;
-    verb.Process(verb_in[0], verb_in[1], &(verb_out[0]), &(verb_out[1]));
+    if (is_verb_on) {
+      verb.Process(verb_in[0], verb_in[1], &(verb_out[0]), &(verb_out[1]));
+      verb_sentinel.Watch(verb_out[0]);
+      verb_sentinel.Watch(verb_out[1]);
+    }
     verb_fade.SetStage(verb_bypass);
     verb_fade.Process(bus0, bus1, verb_out[0], verb_out[1], bus0, bus1);
 
-    out[0][i] = SoftLimit(bus0);
-    out[1][i] = SoftLimit(bus1);
+    out0[i] = SoftLimit(master_sentinel.Watch(bus0));
+    out1[i] = SoftLimit(master_sentinel.Watch(bus1));
+  }
+}
+
+void AudioCallback(float **in, float **out, size_t size) {
+  RTGuard::Scope rt_guard;
+
+  auto is_verb_on = !verb_reset.IsPending();
+  for (size_t offset = 0; offset < size; offset += kMaxBlockSize) {
+    auto chunk = std::min(size - offset, kMaxBlockSize);
+    // One LFO sample per chunk, the phase skips the rest of it
+    auto t = dly_time + 0.25 * lfo.Process();
+    lfo.PhaseAdd((chunk - 1) * lfo_freq * sample_time);
+    if(t < 0) {
+      t = 0;
+    }
+    dly.SetDelayTime(t);
+    Render(in[0] + offset, in[1] + offset, out[0] + offset, out[1] + offset, chunk, is_verb_on);
+  }
+
+  // Recover from blow-ups in the same block
+  auto is_dly_bad = dly_sentinel.Check();
+  auto is_verb_bad = verb_sentinel.Check();
+  auto is_master_bad = master_sentinel.Check();
+  if (is_dly_bad || is_master_bad) {
+    dly.Reset();
+  }
+  if (is_verb_bad || is_master_bad) {
+    verb_out[0] = verb_out[1] = 0.f;
+    verb_reset.Request();
+  }
+  if (is_master_bad) {
+    for (size_t i = 0; i < size; i++) {
+      out[0][i] = out[1][i] = 0.f;
+    }
   }
 }
 
@@ -217,8 +296,7 @@ void setup() {
   dcm_mix_values[1].Init(.35f);
   dcm_mix_values[2].Init(.5f);
 
-  drv[0].Init();
-  drv[1].Init();
+  drv.Init();
   drv_fade.SetStage(1.f);
 
   for (auto& d: dcm) {
@@ -230,16 +308,14 @@ void setup() {
   verb.Init(sample_rate);
   verb.SetLpFreq(8000.f);
 
-  dly[0].Init(sample_rate, delay_buf0);
-  dly[0].SetLagTime(.3f);
-  dly[0].SetFeedback(.6f);
-  
-  dly[1].Init(sample_rate, delay_buf1);
-  dly[1].SetLagTime(.3f);
-  dly[1].SetFeedback(.6f);
+  dly.Init(sample_rate, delay_buf0, delay_buf1);
+  dly.SetLagTime(.3f);
+  dly.SetFeedback(.6f);
   
+  sample_time = 1.f / sample_rate;
   lfo.Init(sample_rate);
   lfo.SetWaveform(Oscillator::WAVE_TRI);
+  lfo.SetFreq(lfo_freq);
 
   // BEGIN CALLBACK
   DAISY.begin(AudioCallback);
@@ -250,17 +326,27 @@ void loop() {
   //PROCESS TOUCH SENSOR
   touch.Process();
 
-  lfo.SetFreq(fmap(dly_mod_speed_knob.Process(), 0.05, 10.0));
-  lfo.SetAmp(fmap(dly_mod_amount_knob.Process(), 0.f, 0.05f));  
+  auto dly_mod_speed = dly_mod_speed_knob.Process();
+  if (dly_mod_speed_knob.HasChanged()) {
+    lfo_freq = fmap(dly_mod_speed, 0.05, 10.0);
+    lfo.SetFreq(lfo_freq);
+  }
+  auto dly_mod_amount = dly_mod_amount_knob.Process();
+  if (dly_mod_amount_knob.HasChanged()) lfo.SetAmp(fmap(dly_mod_amount, 0.f, 0.05f));
 
   //Process knob values
   dly_mix = dly_mix_knob.Process();
   dly_time = fmap(dly_time_fader.Process(), 0.01f, 5.f, Mapping::EXP);
   auto dly_fb = dly_fb_knob.Process() * 1.02;
-  dly[0].SetFeedback(dly_fb);
-  dly[1].SetFeedback(dly_fb);
+  if (dly_fb_knob.HasChanged()) {
+    dly.SetFeedback(dly_fb);
+  }
 
-  verb.SetFeedback(fmap(verb_fb_fader.Process(), 0.3f, 1.f));
+  auto verb_fb_value = verb_fb_fader.Process();
+  if (verb_fb_fader.HasChanged()) {
+    verb_fb = fmap(verb_fb_value, 0.3f, 1.f);
+    verb.SetFeedback(verb_fb);
+  }
   verb_send = verb_send_knob.Process();
   auto verb_mix_drv_level = verb_mix_drv_level_knob.Process();
 
@@ -295,5 +381,10 @@ void loop() {
   }
   latch = new_latch;
 
+  verb_reset.Run(ResetReverb);
+
+  Sentinel::Report();
+  RTGuard::Report();
+
   delay(4);
 }
@@ -13,6 +13,8 @@ class AKnob {
           float coeff = 0.2,
           float quant = 200.f):
           val_    { 0.0f },
+          out_    { 0.0f },
+          changed_ { true },
           pin_    { pin },
           coeff_  { coeff },
           quant_  { quant },
@@ -30,7 +32,18 @@ class AKnob {
       if (flip_) t = 1.f - t;
       if (invert_) t = -t;
       val_ += coeff_ * (t - val_);
-      return round(val_ * quant_) / quant_;
+      auto out = round(val_ * quant_) / quant_;
+      if (out != out_) changed_ = true;
+      out_ = out;
+      return out;
+    }
+
+    // True if the quantized value moved since the last call.
+    // Starts out true so the first reading gets applied.
+    bool HasChanged() {
+      auto changed = changed_;
+      changed_ = false;
+      return changed;
     }
 
   private:
@@ -43,6 +56,8 @@ class AKnob {
     uint8_t pin_;
     float coeff_; 
     float val_;
+    float out_;
+    bool  changed_;
     float quant_;
     bool  flip_;
     bool  invert_;
@@ -6,6 +6,14 @@
 #include <array>
 #include "DaisyDSP.h"
 
+// Block processing goes through CMSIS-DSP when USE_CMSIS_DSP is
+// defined, the portable loop otherwise. It changes the class layout,
+// so define it for the whole build (biquad.cpp too), e.g. with
+// -DUSE_CMSIS_DSP in compiler.cpp.extra_flags in platform.local.txt.
+#ifdef USE_CMSIS_DSP
+#include <arm_math.h>
+#endif
+
 namespace infrasonic {
 
 /**
@@ -36,32 +44,75 @@ class BiquadSection {
 
         void SetCoefficients(const Coefficients coefficients) { coefs_ = coefficients; }
 
+        const Coefficients &GetCoefficients() const { return coefs_; }
+
+        /// Clears the filter state, keeps the coefficients
+        void Reset()
+        {
+            for (auto &state : state_) {
+                state[0] = state[1] = 0;
+            }
+        }
+
         inline float Process(const float in, const int channel)
         {
             assert(channel < 2);
 
-            // TODO: arm accelerated version
-
             const float &b0 = coefs_[0];
             const float &b1 = coefs_[1];
             const float &b2 = coefs_[2];
             const float &a1 = coefs_[3];
             const float &a2 = coefs_[4];
 
+            float &s1 = state_[channel][0];
+            float &s2 = state_[channel][1];
+
             // Transposed direct form 2
-            float y = b0 * in + s1_[channel];
-            s1_[channel] = s2_[channel] + in * b1 - a1 * y;
-            s2_[channel] = b2 * in - a2 * y;
+            float y = b0 * in + s1;
+            s1 = s2 + in * b1 - a1 * y;
+            s2 = b2 * in - a2 * y;
             return y;
         }
 
+        /// In-place stereo block processing, same results as Process() sample by sample.
+        /// Both channels run in one loop with the state held in registers.
+        inline void ProcessBlock(float *left, float *right, const size_t size)
+        {
+            const float b0 = coefs_[0];
+            const float b1 = coefs_[1];
+            const float b2 = coefs_[2];
+            const float a1 = coefs_[3];
+            const float a2 = coefs_[4];
+
+            float l1 = state_[0][0], l2 = state_[0][1];
+            float r1 = state_[1][0], r2 = state_[1][1];
+
+            for (size_t i = 0; i < size; i++) {
+                const float l = left[i];
+                const float r = right[i];
+                const float yl = b0 * l + l1;
+                const float yr = b0 * r + r1;
+                l1 = l2 + l * b1 - a1 * yl;
+                r1 = r2 + r * b1 - a1 * yr;
+                l2 = b2 * l - a2 * yl;
+                r2 = b2 * r - a2 * yr;
+                left[i] = yl;
+                right[i] = yr;
+            }
+
+            state_[0][0] = l1; state_[0][1] = l2;
+            state_[1][0] = r1; state_[1][1] = r2;
+        }
+
+        /// {s1, s2} of the channel, the layout CMSIS-DSP df2T keeps per stage
+        float *State(const int channel) { return state_[channel]; }
+
     private:
         // coef
         Coefficients coefs_{0, 0, 0, 0, 0};
 
-        // state
-        float s1_[2] = {0, 0};
-        float s2_[2] = {0, 0};
+        // state, per channel
+        float state_[2][2] = {{0, 0}, {0, 0}};
 
 };
 
@@ -130,6 +181,14 @@ class BiquadCascade {
             return out;
         }
 
+        /// Clears the state of every section
+        inline void Reset()
+        {
+            for (auto &biquad : biquads_) {
+                biquad.Reset();
+            }
+        }
+
         /// In-place stereo processing
         inline void ProcessStereo(float &sampL, float &sampR)
         {
@@ -139,6 +198,34 @@ class BiquadCascade {
             }
         }
 
+        /// In-place stereo block processing, same results as ProcessStereo() sample by sample
+        inline void ProcessBlock(float *left, float *right, const size_t size)
+        {
+#ifdef USE_CMSIS_DSP
+            float *buffers[2] = {left, right};
+            for (int ch = 0; ch < 2; ch++) {
+                // CMSIS wants every stage's state in one array
+                float state[2 * NumSections];
+                for (size_t i = 0; i < NumSections; i++) {
+                    state[2 * i] = biquads_[i].State(ch)[0];
+                    state[2 * i + 1] = biquads_[i].State(ch)[1];
+                }
+                arm_biquad_cascade_df2T_instance_f32 instance = {
+                    static_cast<uint8_t>(NumSections), state, arm_coefs_
+                };
+                arm_biquad_cascade_df2T_f32(&instance, buffers[ch], buffers[ch], size);
+                for (size_t i = 0; i < NumSections; i++) {
+                    biquads_[i].State(ch)[0] = state[2 * i];
+                    biquads_[i].State(ch)[1] = state[2 * i + 1];
+                }
+            }
+#else
+            for (auto &biquad : biquads_) {
+                biquad.ProcessBlock(left, right, size);
+            }
+#endif
+        }
+
     private:
 
         float sample_rate_;
@@ -146,9 +233,23 @@ class BiquadCascade {
 
         std::array<BiquadSection, NumSections> biquads_;
 
+#ifdef USE_CMSIS_DSP
+        // {b0, b1, b2, -a1, -a2} per section, CMSIS adds the feedback terms
+        float arm_coefs_[5 * NumSections];
+#endif
+
         inline void updateCoefficients() {
             for (size_t i=0; i<NumSections; i++) {
                 biquads_[i].SetCoefficients(BiquadSection::CalculateCoefficients(FilterType, sample_rate_, cutoff_hz_, q_[i]));
+#ifdef USE_CMSIS_DSP
+                const auto &coefs = biquads_[i].GetCoefficients();
+                float *arm = arm_coefs_ + 5 * i;
+                arm[0] = coefs[0];
+                arm[1] = coefs[1];
+                arm[2] = coefs[2];
+                arm[3] = -coefs[3];
+                arm[4] = -coefs[4];
+#endif
             }
         }
 };
@@ -2,59 +2,73 @@
 #include <stdlib.h>
 #include <stdint.h>
 
-/** Simple Delay line.
-November 2019
+/** Delay line with a power of two capacity.
+    max_size is rounded up to the next power of two (kCapacity), so every
+    index wraps with a mask instead of a modulo. The buffer passed to Init()
+    must hold kCapacity samples.
 
-Converted to Template December 2019
+    The write pointer moves forward, so a block of samples is contiguous
+    in the buffer (apart from the wrap) and the block calls below are plain
+    loops the compiler can unroll.
 
-declaration example: (1 second of floats)
-
-DelayLine<float, SAMPLE_RATE> del;
-
-By: shensley
+    Derived from the DaisySP DelayLine by shensley.
 */
 template <typename T, size_t max_size>
-class DeLine
+class MaskedDeLine
 {
   public:
-    DeLine() {}
-    ~DeLine() {}
+    static constexpr size_t kCapacity = [] {
+        size_t size = 1;
+        while(size < max_size)
+            size <<= 1;
+        return size;
+    }();
+
+    MaskedDeLine() {}
+    ~MaskedDeLine() {}
     /** initializes the delay line by clearing the values within, and setting delay to 1 sample.
     */
-    void Init(float* buf) { 
-      line_ = buf;
-      Reset(); 
+    void Init(T* buf)
+    {
+        line_ = buf;
+        Reset();
     }
     /** clears buffer, sets write ptr to 0, and delay to 1 sample.
     */
     void Reset()
     {
-        for(size_t i = 0; i < max_size; i++)
+        Clear(0, kCapacity);
+        write_ptr_ = 0;
+        delay_     = 1;
+        frac_      = 0.0f;
+    }
+
+    /** clears count samples starting at start, without touching the pointers.
+    */
+    inline void Clear(size_t start, size_t count)
+    {
+        size_t end = start + count < kCapacity ? start + count : kCapacity;
+        for(size_t i = start; i < end; i++)
         {
             line_[i] = 0;
         }
-        write_ptr_ = 0;
-        delay_     = 1;
     }
 
     /** sets the delay time in samples
-        If a float is passed in, a fractional component will be calculated for interpolating the delay line.
     */
     inline void SetDelay(size_t delay)
     {
         frac_  = 0.0f;
-        delay_ = delay < max_size ? delay : max_size - 1;
+        delay_ = delay < kCapacity ? delay : kCapacity - 1;
     }
 
-    /** sets the delay time in samples
-        If a float is passed in, a fractional component will be calculated for interpolating the delay line.
+    /** sets the delay time in samples, with a fractional part for interpolation.
     */
     inline void SetDelay(float delay)
     {
-        int32_t int_delay = static_cast<int32_t>(delay);
-        frac_             = delay - static_cast<float>(int_delay);
-        delay_ = static_cast<size_t>(int_delay) < max_size ? int_delay
-                                                           : max_size - 1;
+        size_t int_delay = static_cast<size_t>(delay);
+        frac_            = delay - static_cast<float>(int_delay);
+        delay_           = int_delay < kCapacity ? int_delay : kCapacity - 1;
     }
 
     /** writes the sample of type T to the delay line, and advances the write ptr
@@ -62,38 +76,38 @@ class DeLine
     inline void Write(const T sample)
     {
         line_[write_ptr_] = sample;
-        write_ptr_        = (write_ptr_ - 1 + max_size) % max_size;
+        write_ptr_        = (write_ptr_ + 1) & kMask;
     }
 
     /** returns the next sample of type T in the delay line, interpolated if necessary.
     */
     inline const T Read() const
     {
-        T a = line_[(write_ptr_ + delay_) % max_size];
-        T b = line_[(write_ptr_ + delay_ + 1) % max_size];
+        T a = line_[(write_ptr_ - delay_) & kMask];
+        T b = line_[(write_ptr_ - delay_ - 1) & kMask];
         return a + (b - a) * frac_;
     }
 
     /** Read from a set location */
     inline const T Read(float delay) const
     {
-        int32_t delay_integral   = static_cast<int32_t>(delay);
+        size_t  delay_integral   = static_cast<size_t>(delay);
         float   delay_fractional = delay - static_cast<float>(delay_integral);
-        const T a = line_[(write_ptr_ + delay_integral) % max_size];
-        const T b = line_[(write_ptr_ + delay_integral + 1) % max_size];
+        const T a = line_[(write_ptr_ - delay_integral) & kMask];
+        const T b = line_[(write_ptr_ - delay_integral - 1) & kMask];
         return a + (b - a) * delay_fractional;
     }
 
     inline const T ReadHermite(float delay) const
     {
-        int32_t delay_integral   = static_cast<int32_t>(delay);
+        size_t  delay_integral   = static_cast<size_t>(delay);
         float   delay_fractional = delay - static_cast<float>(delay_integral);
 
-        int32_t     t     = (write_ptr_ + delay_integral + max_size);
-        const T     xm1   = line_[(t - 1) % max_size];
-        const T     x0    = line_[(t) % max_size];
-        const T     x1    = line_[(t + 1) % max_size];
-        const T     x2    = line_[(t + 2) % max_size];
+        size_t      t     = write_ptr_ - delay_integral;
+        const T     xm1   = line_[(t + 1) & kMask];
+        const T     x0    = line_[t & kMask];
+        const T     x1    = line_[(t - 1) & kMask];
+        const T     x2    = line_[(t - 2) & kMask];
         const float c     = (x1 - xm1) * 0.5f;
         const float v     = x0 - x1;
         const float w     = c + v;
@@ -105,15 +119,87 @@ class DeLine
 
     inline const T Allpass(const T sample, size_t delay, const T coefficient)
     {
-        T read  = line_[(write_ptr_ + delay) % max_size];
+        T read  = line_[(write_ptr_ - delay) & kMask];
         T write = sample + coefficient * read;
         Write(write);
         return -write * coefficient + read;
     }
 
+    /** writes size samples and advances the write ptr past them.
+    */
+    inline void Write(const T* in, size_t size)
+    {
+        while(size > 0)
+        {
+            size_t run = kCapacity - write_ptr_ < size ? kCapacity - write_ptr_ : size;
+            T*     dst = line_ + write_ptr_;
+            for(size_t i = 0; i < run; i++)
+            {
+                dst[i] = in[i];
+            }
+            write_ptr_ = (write_ptr_ + run) & kMask;
+            in += run;
+            size -= run;
+        }
+    }
+
+    /** reads size samples, interpolated, for a block that Write() is about
+        to write: sample i is read delay + i * increment samples behind its own
+        write position. The delay has to stay above size, so the block only
+        reads samples written before it.
+    */
+    inline void Read(T* out, size_t size, float delay, const float increment) const
+    {
+        for(size_t i = 0; i < size; i++)
+        {
+            float   d                = delay + static_cast<float>(i) * increment;
+            size_t  delay_integral   = static_cast<size_t>(d);
+            float   delay_fractional = d - static_cast<float>(delay_integral);
+            size_t  t                = write_ptr_ + i - delay_integral;
+            const T a                = line_[t & kMask];
+            const T b                = line_[(t - 1) & kMask];
+            out[i]                   = a + (b - a) * delay_fractional;
+        }
+    }
+
+    /** block Read() with 4-point Hermite interpolation. It reads one sample
+        newer than Read(), so the delay has to stay above size + 1.
+    */
+    inline void ReadHermite(T* out, size_t size, float delay, const float increment) const
+    {
+        for(size_t i = 0; i < size; i++)
+        {
+            float       d                = delay + static_cast<float>(i) * increment;
+            size_t      delay_integral   = static_cast<size_t>(d);
+            float       delay_fractional = d - static_cast<float>(delay_integral);
+            size_t      t                = write_ptr_ + i - delay_integral;
+            const T     xm1              = line_[(t + 1) & kMask];
+            const T     x0               = line_[t & kMask];
+            const T     x1               = line_[(t - 1) & kMask];
+            const T     x2               = line_[(t - 2) & kMask];
+            const float c                = (x1 - xm1) * 0.5f;
+            const float v                = x0 - x1;
+            const float w                = c + v;
+            const float a                = w + v + (x2 - x0) * 0.5f;
+            const float b_neg            = w + a;
+            const float f                = delay_fractional;
+            out[i]                       = (((a * f) - b_neg) * f + c) * f + x0;
+        }
+    }
+
+    /** returns the sample written delay samples before the next Write(),
+        offset samples into a block. For interpolators that keep their own state.
+    */
+    inline const T At(size_t delay, size_t offset) const
+    {
+        return line_[(write_ptr_ + offset - delay) & kMask];
+    }
+
   private:
+    static constexpr size_t kMask = kCapacity - 1;
+
     float  frac_;
     size_t write_ptr_;
     size_t delay_;
-    T* line_;
+    T*     line_;
 };
@@ -9,28 +9,59 @@
 
 namespace infrasonic {
 
+/** How StereoEchoDelay reads between samples */
+enum class Interpolation {
+    /// 2 taps, cheapest, dulls the highs a little at fractional delays
+    Linear,
+    /// 4-point Hermite, flatter response for a few more multiplies
+    Hermite,
+    /// 1st order allpass, flat magnitude, best for slow modulation
+    Allpass
+};
+
 /**
  * @brief
- * Tape-ish echo delay.
+ * Tape-ish stereo echo delay that works a block at a time.
  *   - Feedback is unbounded, but signal is soft-clipped
  *   - Output is full-wet, should be mixed with dry signal externally
+ *   - Reset() is safe to call from the audio callback
+ *   - Both channels share one delay time, smoothed once per block:
+ *     the lag is applied over the whole block and the delay ramps
+ *     linearly from the old value to the new.
+ *   - The lines are read and written in blocks of up to kMaxBlock,
+ *     so the shortest delay is kMaxBlock + 2 samples.
  *
  * @tparam MaxLength Max length of delay in samples
+ * @tparam interpolation How the lines are read between samples
  */
-template<size_t MaxLength>
-class EchoDelay {
+template<size_t MaxLength, Interpolation interpolation = Interpolation::Linear>
+class StereoEchoDelay {
 
     public:
 
-        EchoDelay() {}
-        ~EchoDelay() {}
+        /** Samples each buffer passed to Init() must hold, MaxLength rounded up to a power of two */
+        static constexpr size_t kBufferSize = MaskedDeLine<float, MaxLength>::kCapacity;
+
+        /** Longest run processed in one go, longer blocks are split */
+        static constexpr size_t kMaxBlock = 64;
+
+        StereoEchoDelay() {}
+        ~StereoEchoDelay() {}
 
-        void Init(float sample_rate, float *buf)
+        void Init(float sample_rate, float *buf_left, float *buf_right)
         {
             sample_rate_ = sample_rate;
-            delayLine_.Init(buf);
+            delayLines_[0].Init(buf_left);
+            delayLines_[1].Init(buf_right);
+            clear_pos_ = kBufferSize;
             bpf_.Init(sample_rate);
             bpf_.SetParams(800.0f, 0.f);
+            delay_time_current_ = delay_time_target_ = 0.f;
+            delay_smooth_coef_ = 1.f;
+            block_size_ = 0;
+            block_decay_ = 0.f;
+            feedback_ = 0.f;
+            resetAllpass();
         }
 
         /**
@@ -39,12 +70,13 @@ class EchoDelay {
         void SetLagTime(const float time_s)
         {
             delay_smooth_coef_ = onepole_coef(time_s, sample_rate_);
+            block_size_ = 0;
         }
 
         /**
-         * @brief Set the Delay Time in seconds
+         * @brief Set the Delay Time in seconds, read once per block
          *
-         * @param time_s Delay time in seconds. Will be truncated to MaxLength.
+         * @param time_s Delay time in seconds. Will be clamped to the usable range.
          * @param immediately If true, sets delay time immediately with no smoothing.
          */
         void SetDelayTime(const float time_s, bool immediately = false)
@@ -59,42 +91,141 @@ class EchoDelay {
          * This can be >1 in magnitude for saturated swells, or negative.
          *
          * NOTE: This is not internally smoothed. Use external smoothing if desired.
-         *
-         * @param feedback
          */
         void SetFeedback(const float feedback)
         {
             feedback_ = feedback;
         }
 
-        inline float Process(const float in)
+        /**
+         * @brief
+         * Clear both lines and the filter state. The lines are cleared
+         * kClearChunk samples per sample processed; the output is muted
+         * until they are clear.
+         */
+        void Reset()
+        {
+            clear_pos_ = 0;
+            bpf_.Reset();
+            resetAllpass();
+        }
+
+        /**
+         * @brief Process size samples of both channels, full-wet.
+         * out may be the same buffers as in.
+         */
+        void ProcessBlock(const float* const* in, float** out, size_t size)
         {
-            float out;
-            daisysp::fonepole(delay_time_current_, delay_time_target_, delay_smooth_coef_);
-            delayLine_.SetDelay(delay_time_current_ * sample_rate_);
-            out = delayLine_.Read();
-            out = bpf_.Process(out);
-            out = daisysp::SoftClip(out);
-            delayLine_.Write(out * feedback_ + in);
-            return out;
+            for (size_t offset = 0; offset < size; offset += kMaxBlock) {
+                size_t run = size - offset < kMaxBlock ? size - offset : kMaxBlock;
+                processRun(in[0] + offset, in[1] + offset, out[0] + offset, out[1] + offset, run);
+            }
         }
 
     private:
 
-        EchoDelay(const EchoDelay &other) = delete;
-        EchoDelay(EchoDelay &&other) = delete;
-        EchoDelay& operator=(const EchoDelay &other) = delete;
-        EchoDelay& operator=(EchoDelay &&other) = delete;
+        StereoEchoDelay(const StereoEchoDelay &other) = delete;
+        StereoEchoDelay(StereoEchoDelay &&other) = delete;
+        StereoEchoDelay& operator=(const StereoEchoDelay &other) = delete;
+        StereoEchoDelay& operator=(StereoEchoDelay &&other) = delete;
+
+        static constexpr size_t kClearChunk = 64;
+        static constexpr float kMinDelay = static_cast<float>(kMaxBlock + 2);
+        static constexpr float kMaxDelay = static_cast<float>(MaxLength - 3);
+
+        inline void processRun(const float *in_left, const float *in_right, float *out_left, float *out_right, size_t size)
+        {
+            if (clear_pos_ < kBufferSize) {
+                for (auto &line : delayLines_) {
+                    line.Clear(clear_pos_, kClearChunk * size);
+                }
+                clear_pos_ += kClearChunk * size;
+                for (size_t i = 0; i < size; i++) {
+                    out_left[i] = out_right[i] = 0.f;
+                }
+                return;
+            }
+
+            // Same as running fonepole() size times towards a fixed target
+            if (size != block_size_) {
+                block_size_ = size;
+                block_decay_ = powf(1.f - delay_smooth_coef_, static_cast<float>(size));
+            }
+            const float start = clampDelay(delay_time_current_ * sample_rate_);
+            delay_time_current_ = delay_time_target_ + (delay_time_current_ - delay_time_target_) * block_decay_;
+            const float end = clampDelay(delay_time_current_ * sample_rate_);
+            const float increment = (end - start) / static_cast<float>(size);
+
+            float read[2][kMaxBlock];
+            for (size_t ch = 0; ch < 2; ch++) {
+                readLine(ch, read[ch], size, start + increment, increment);
+            }
+
+            bpf_.ProcessBlock(read[0], read[1], size);
+
+            float write[2][kMaxBlock];
+            for (size_t i = 0; i < size; i++) {
+                const float left = daisysp::SoftClip(read[0][i]);
+                const float right = daisysp::SoftClip(read[1][i]);
+                write[0][i] = left * feedback_ + in_left[i];
+                write[1][i] = right * feedback_ + in_right[i];
+                out_left[i] = left;
+                out_right[i] = right;
+            }
+
+            delayLines_[0].Write(write[0], size);
+            delayLines_[1].Write(write[1], size);
+        }
+
+        inline void readLine(const size_t ch, float *out, const size_t size, const float delay, const float increment)
+        {
+            auto &line = delayLines_[ch];
+            if constexpr (interpolation == Interpolation::Linear) {
+                line.Read(out, size, delay, increment);
+            }
+            else if constexpr (interpolation == Interpolation::Hermite) {
+                line.ReadHermite(out, size, delay, increment);
+            }
+            else {
+                // Thiran allpass, the fraction kept in [0.5, 1.5) so the
+                // coefficient stays well inside the unit circle
+                float last = allpass_state_[ch];
+                for (size_t i = 0; i < size; i++) {
+                    float d = delay + static_cast<float>(i) * increment - 0.5f;
+                    size_t delay_integral = static_cast<size_t>(d);
+                    float frac = d - static_cast<float>(delay_integral) + 0.5f;
+                    float eta = (1.f - frac) / (1.f + frac);
+                    last = line.At(delay_integral + 1, i) + eta * (line.At(delay_integral, i) - last);
+                    out[i] = last;
+                }
+                allpass_state_[ch] = last;
+            }
+        }
+
+        inline float clampDelay(const float delay) const
+        {
+            return daisysp::fclamp(delay, kMinDelay, kMaxDelay);
+        }
+
+        inline void resetAllpass()
+        {
+            allpass_state_[0] = allpass_state_[1] = 0.f;
+        }
 
         float sample_rate_;
         float delay_time_current_;
         float delay_time_target_;
         float delay_smooth_coef_;
+        size_t block_size_;
+        float block_decay_;
 
         float feedback_;
 
-        DeLine<float, MaxLength> delayLine_;
+        size_t clear_pos_;
+
+        MaskedDeLine<float, MaxLength> delayLines_[2];
         BPF12 bpf_;
+        float allpass_state_[2];
 };
 
 }
@@ -7,12 +7,14 @@ class MValue {
     MValue(): 
       _is_active    { false },
       _is_changing  { false },
+      _has_changed  { true },
       _init_value   { 0.f },
       _value        { 0.f } 
       {};
 
   void Init(float value) {
     _value = value;
+    _has_changed = true;
   }
 
   void SetActive(bool active, float value) {
@@ -29,6 +31,7 @@ class MValue {
     if (!_is_active) return _value;
     if (!_is_changing && abs(value - _init_value) < kTreshold) return _value;
     _is_changing = true;
+    if (value != _value) _has_changed = true;
     _value = value;
     return _value;
   }
@@ -37,6 +40,14 @@ class MValue {
     return _is_changing;
   }
 
+  // True if the value moved since the last call.
+  // Starts out true so the initial value gets applied.
+  bool HasChanged() {
+    auto changed = _has_changed;
+    _has_changed = false;
+    return changed;
+  }
+
   float Value() {
     return _value;
   }
@@ -46,6 +57,7 @@ class MValue {
 
     bool _is_active;
     bool _is_changing;
+    bool _has_changed;
     float _init_value;
     float _value;
 };
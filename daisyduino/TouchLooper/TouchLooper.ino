@@ -1,6 +1,11 @@
 // SYNTHUX ACADEMY /////////////////////////////////////////
 // TRIPLE LOOPER ///////////////////////////////////////////
+// Uncomment to count heap allocations and
+// blocking calls made in the audio callback.
+// #define RT_GUARD
+
 #include "simple-daisy-touch.h"
+#include "rtguard.h"
 #include "detector.h"
 #include "looper.h"
 #include "aknob.h"
@@ -8,6 +13,25 @@
 #include "hann.h"
 #include "xfade.h"
 
+// Uncomment to play the gesture script from script.h
+// instead of reading the pads and knobs.
+// CPU load is reported over Serial when the script ends.
+// #define GESTURE_REPLAY
+
+// Uncomment to print the session over Serial
+// as gesture script lines for script.h.
+// #define GESTURE_RECORD
+
+#ifdef GESTURE_REPLAY
+#include "gesture.h"
+#include "load.h"
+#include "script.h"
+#endif
+
+#ifdef GESTURE_RECORD
+#include "gesture.h"
+#endif
+
 using namespace synthux;
 
 ////////////////////////////////////////////////////////////
@@ -31,6 +55,23 @@ static synthux::Looper<kWindowSlope> layers[kLayerCount];
 static ReverbSc verb;
 static XFade xfade;
 
+#ifdef GESTURE_REPLAY
+static GesturePlayer<> replay;
+static CpuLoad load;
+
+uint16_t ReadScriptKnob(uint8_t pin) {
+  return replay.Knob(pin - A(S30));
+}
+#endif
+
+#ifdef GESTURE_RECORD
+static GestureRecorder<> recorder;
+
+uint16_t RecordKnob(uint8_t pin) {
+  return recorder.Knob(pin - A(S30), analogRead(pin));
+}
+#endif
+
 ////////////////////////////////////////////////////////////
 ///////////////////// KNOBS & SWITCHES /////////////////////
 //
@@ -141,6 +182,11 @@ float verb_out[2];
 float mix_volume[kLayerCount][2];
 float bus[2];
 void AudioCallback(float **in, float **out, size_t size) {
+  RTGuard::Scope rt_guard;
+  #ifdef GESTURE_REPLAY
+  load.Begin();
+  #endif
+
   for (size_t i = 0; i < size; i++) {
     detector.Process(in[0][i], in[1][i], pre_out[0], pre_out[1]);
     buffer.SetRecording(detector.IsOpen());
@@ -171,6 +217,15 @@ void AudioCallback(float **in, float **out, size_t size) {
     out[0][i] = SoftClip(bus[0]);
     out[1][i] = SoftClip(bus[1]);
   }
+
+  #ifdef GESTURE_REPLAY
+  replay.Advance(size);
+  load.End();
+  #endif
+
+  #ifdef GESTURE_RECORD
+  recorder.Advance(size);
+  #endif
 }
 
 ///////////////////////////////////////////////////////////////
@@ -203,6 +258,17 @@ void setup() {
 
   pinMode(LED_BUILTIN, OUTPUT);
 
+  #ifdef GESTURE_REPLAY
+  replay.Init(kScript, kScriptLength, sample_rate);
+  load.Init(sample_rate, DAISY.AudioBlockSize());
+  AKnob<>::SetSource(ReadScriptKnob);
+  #endif
+
+  #ifdef GESTURE_RECORD
+  recorder.Init(sample_rate);
+  AKnob<>::SetSource(RecordKnob);
+  #endif
+
   DAISY.begin(AudioCallback);
 }
 
@@ -220,7 +286,16 @@ void loop() {
   auto loop_length = fmap(length_knob.Process(), 0.f, 1.f, Mapping::EXP);
   auto release_verb = release_verb_knob.Process();
 
+  #ifdef GESTURE_REPLAY
+  if (replay.Process()) load.Report();
+  touch.Process(replay.Pads());
+  #else
   touch.Process();
+  #endif
+
+  #ifdef GESTURE_RECORD
+  recorder.Pads(touch.State());
+  #endif
 
   layer_on = false;
   for (auto i = 0; i < kLayerCount; i++) {
@@ -303,5 +378,11 @@ void loop() {
   }
   digitalWrite(LED_BUILTIN, led_on);
 
+  #ifdef GESTURE_RECORD
+  recorder.Flush();
+  #endif
+
+  RTGuard::Report();
+
   delay(4);
 }
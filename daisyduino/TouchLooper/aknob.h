@@ -25,8 +25,14 @@ class AKnob {
       val_ = _read();
     }
 
+    // Replaces analogRead as the source of raw values
+    // for all knobs, e.g. with a gesture player.
+    static void SetSource(uint16_t(*source)(uint8_t pin)) {
+      source_ = source;
+    }
+
     float Process() {
-      float t = static_cast<float>(analogRead(pin_)) * kFrac;
+      float t = _read();
       if (flip_) t = 1.f - t;
       if (invert_) t = -t;
       val_ += coeff_ * (t - val_);
@@ -37,9 +43,12 @@ class AKnob {
     static constexpr float kFrac = 1.f / (powf(2.f, bits) - 1.f);
 
     float _read() {
-      return static_cast<float>(analogRead(pin_)) * kFrac;
+      auto raw = source_ != nullptr ? source_(pin_) : analogRead(pin_);
+      return static_cast<float>(raw) * kFrac;
     }
 
+    static inline uint16_t(*source_)(uint8_t pin) = nullptr;
+
     uint8_t pin_;
     float coeff_; 
     float val_;
@@ -0,0 +1,235 @@
+#pragma once
+#include <array>
+#include <stdint.h>
+
+namespace synthux {
+
+/**
+ * @brief
+ * A single control event of a performance.
+ * Time is counted in ms since the start of the session,
+ * so a script plays the same at any sample rate.
+ */
+struct Gesture {
+  enum Type : uint8_t {
+    kPad = 0, // index: pad 0...11, value: 1 - touched, 0 - released
+    kKnob,    // index: 0...7 for S30...S37, value: raw ADC reading
+    kSwitch   // index: switch number, value: position 0...2
+  };
+
+  uint32_t time;
+  uint8_t  type;
+  uint8_t  index;
+  uint16_t value;
+};
+
+/**
+ * @brief
+ * Replays a gesture script in place of the touch sensor,
+ * the knobs and the switches. The sample clock is advanced
+ * from the audio callback, events are applied from loop(),
+ * so the script runs exactly like a live session would.
+ */
+template<size_t knob_count = 8, size_t switch_count = 2>
+class GesturePlayer {
+public:
+  GesturePlayer():
+    _script       { nullptr },
+    _length       { 0 },
+    _next         { 0 },
+    _sample_rate  { 48000 },
+    _time         { 0 },
+    _pads         { 0 },
+    _finished     { false }
+    {
+      _knobs.fill(0);
+      _switches.fill(0);
+    }
+
+  void Init(const Gesture* script, const size_t length, const uint32_t sample_rate) {
+    _script = script;
+    _length = length;
+    _sample_rate = sample_rate;
+    _next = 0;
+    _time = 0;
+    _pads = 0;
+    _finished = false;
+  }
+
+  // Called from the audio callback.
+  void Advance(const size_t frames) {
+    _time += frames;
+  }
+
+  // Called from loop(). Applies all events that are due.
+  // Returns true once, when the last event has been applied.
+  bool Process() {
+    if (_finished) return false;
+    uint32_t now = _time;
+    while (_next < _length && _samples(_script[_next].time) <= now) {
+      _apply(_script[_next]);
+      _next++;
+    }
+    _finished = (_next == _length);
+    return _finished;
+  }
+
+  bool IsFinished() const {
+    return _finished;
+  }
+
+  uint32_t Time() const {
+    return _time;
+  }
+
+  uint16_t Pads() const {
+    return _pads;
+  }
+
+  uint16_t Knob(const size_t index) const {
+    return index < knob_count ? _knobs[index] : 0;
+  }
+
+  uint32_t Switch(const size_t index) const {
+    return index < switch_count ? _switches[index] : 0;
+  }
+
+private:
+  uint64_t _samples(const uint32_t ms) const {
+    return static_cast<uint64_t>(ms) * _sample_rate / 1000;
+  }
+
+  void _apply(const Gesture& g) {
+    switch (g.type) {
+      case Gesture::kPad:
+        if (g.value) _pads |= (1 << g.index);
+        else _pads &= ~(1 << g.index);
+        break;
+
+      case Gesture::kKnob:
+        if (g.index < knob_count) _knobs[g.index] = g.value;
+        break;
+
+      case Gesture::kSwitch:
+        if (g.index < switch_count) _switches[g.index] = g.value;
+        break;
+    }
+  }
+
+  const Gesture* _script;
+  size_t _length;
+  size_t _next;
+  uint32_t _sample_rate;
+  volatile uint32_t _time;
+  uint16_t _pads;
+  std::array<uint16_t, knob_count> _knobs;
+  std::array<uint32_t, switch_count> _switches;
+  bool _finished;
+};
+
+/**
+ * @brief
+ * Records pad changes, quantised knob values and switch
+ * positions with sample timestamps into a ring in SRAM.
+ * Flush() is called from loop() and prints a few events
+ * per call over Serial as gesture script lines, ready
+ * to be pasted into script.h and replayed.
+ */
+template<size_t capacity = 256, size_t knob_count = 8, size_t switch_count = 2>
+class GestureRecorder {
+public:
+  GestureRecorder():
+    _sample_rate  { 48000 },
+    _time         { 0 },
+    _read         { 0 },
+    _write        { 0 },
+    _dropped      { 0 },
+    _pads         { 0 }
+    {
+      _knobs.fill(kUnknown);
+      _switches.fill(kUnknown);
+    }
+
+  void Init(const uint32_t sample_rate) {
+    _sample_rate = sample_rate;
+  }
+
+  // Called from the audio callback.
+  void Advance(const size_t frames) {
+    _time += frames;
+  }
+
+  void Pads(const uint16_t state) {
+    auto changed = state ^ _pads;
+    for (uint8_t i = 0; changed != 0; i++, changed >>= 1) {
+      if (changed & 1) _push(Gesture::kPad, i, (state >> i) & 1);
+    }
+    _pads = state;
+  }
+
+  // Raw ADC reading, quantised to 1/kKnobSteps of the range.
+  uint16_t Knob(const size_t index, const uint16_t raw, const uint16_t raw_max = 1023) {
+    if (index >= knob_count) return raw;
+    auto step = static_cast<uint16_t>((static_cast<uint32_t>(raw) * kKnobSteps + raw_max / 2) / raw_max);
+    if (step != _knobs[index]) {
+      _knobs[index] = step;
+      _push(Gesture::kKnob, index, static_cast<uint32_t>(step) * raw_max / kKnobSteps);
+    }
+    return raw;
+  }
+
+  void Switch(const size_t index, const uint32_t position) {
+    if (index >= switch_count || position == _switches[index]) return;
+    _switches[index] = position;
+    _push(Gesture::kSwitch, index, position);
+  }
+
+  // Called from loop(). Prints up to max_events lines.
+  void Flush(const size_t max_events = 4) {
+    for (size_t i = 0; i < max_events && _read != _write; i++) {
+      auto& g = _ring[_read];
+      Serial.print("  { ");
+      Serial.print(static_cast<uint32_t>(static_cast<uint64_t>(g.time) * 1000 / _sample_rate));
+      Serial.print(", Gesture::");
+      Serial.print(kTypeNames[g.type]);
+      Serial.print(", ");
+      Serial.print(g.index);
+      Serial.print(", ");
+      Serial.print(g.value);
+      Serial.println(" },");
+      _read = (_read + 1) % capacity;
+    }
+  }
+
+  uint32_t Dropped() const {
+    return _dropped;
+  }
+
+private:
+  void _push(const uint8_t type, const uint8_t index, const uint16_t value) {
+    auto next = (_write + 1) % capacity;
+    if (next == _read) {
+      _dropped++;
+      return;
+    }
+    _ring[_write] = { _time, type, index, value };
+    _write = next;
+  }
+
+  static constexpr uint16_t kKnobSteps = 200;
+  static constexpr uint32_t kUnknown = 0xffff;
+  static constexpr const char* kTypeNames[3] = { "kPad", "kKnob", "kSwitch" };
+
+  // Times in samples until Flush() prints them in ms
+  std::array<Gesture, capacity> _ring;
+  uint32_t _sample_rate;
+  volatile uint32_t _time;
+  size_t _read;
+  size_t _write;
+  uint32_t _dropped;
+  uint16_t _pads;
+  std::array<uint16_t, knob_count> _knobs;
+  std::array<uint32_t, switch_count> _switches;
+};
+
+};
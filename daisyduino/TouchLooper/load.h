@@ -0,0 +1,87 @@
+#pragma once
+#include <stdint.h>
+
+namespace synthux {
+
+/**
+ * @brief
+ * Audio callback load meter.
+ * Load is the time spent in the callback relative
+ * to the duration of the block, i.e. 1.0 is 100%.
+ */
+class CpuLoad {
+public:
+  CpuLoad():
+    _block_us { 1.f },
+    _start    { 0 }
+    {
+      Reset();
+    }
+
+  void Init(const float sample_rate, const size_t block_size) {
+    _block_us = 1e6f * static_cast<float>(block_size) / sample_rate;
+    Reset();
+  }
+
+  // Call at the top of the audio callback...
+  void Begin() {
+    _start = micros();
+  }
+
+  // ...and at the very end of it.
+  void End() {
+    uint32_t elapsed = micros() - _start;
+    _last_us = elapsed;
+    _sum_us += elapsed;
+    if (elapsed > _max_us) _max_us = elapsed;
+    if (elapsed > _block_us) _overruns++;
+    _count++;
+  }
+
+  float Average() const {
+    return _count > 0 ? static_cast<float>(_sum_us) / (_count * _block_us) : 0.f;
+  }
+
+  // Load of the last block only
+  float Last() const {
+    return static_cast<float>(_last_us) / _block_us;
+  }
+
+  float Max() const {
+    return static_cast<float>(_max_us) / _block_us;
+  }
+
+  uint32_t Overruns() const {
+    return _overruns;
+  }
+
+  void Reset() {
+    _last_us = 0;
+    _sum_us = 0;
+    _max_us = 0;
+    _count = 0;
+    _overruns = 0;
+  }
+
+  void Report() const {
+    Serial.print("CPU avg ");
+    Serial.print(Average() * 100.f);
+    Serial.print("%, max ");
+    Serial.print(Max() * 100.f);
+    Serial.print("%, overruns ");
+    Serial.print(_overruns);
+    Serial.print(" of ");
+    Serial.println(_count);
+  }
+
+private:
+  float _block_us;
+  uint32_t _start;
+  uint32_t _last_us;
+  uint64_t _sum_us;
+  uint32_t _max_us;
+  uint32_t _count;
+  uint32_t _overruns;
+};
+
+};
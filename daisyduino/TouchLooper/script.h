@@ -0,0 +1,52 @@
+#pragma once
+#include "gesture.h"
+
+namespace synthux {
+
+// Three looper layers at 0.3x speed with reverb.
+// Feed audio to the input while the script records.
+// Knob N is S30 + N, see the layout in TouchLooper.ino.
+// Raw speed 639 maps to the 0.3x increment, forward.
+// Times in ms.
+
+static const Gesture kScript[] = {
+  // Initial controls
+  { 0, Gesture::kKnob, 0, 1023 }, // speed
+  { 0, Gesture::kKnob, 2, 800 },  // layer A volume
+  { 0, Gesture::kKnob, 3, 800 },  // layer B volume
+  { 0, Gesture::kKnob, 4, 800 },  // layer C volume
+  { 0, Gesture::kKnob, 5, 0 },    // release / reverb
+  { 0, Gesture::kKnob, 6, 0 },    // loop start
+  { 0, Gesture::kKnob, 7, 1023 }, // loop length
+
+  // Record four seconds
+  { 100, Gesture::kPad, 0, 1 }, { 150, Gesture::kPad, 0, 0 },
+  { 4100, Gesture::kPad, 0, 1 }, { 4150, Gesture::kPad, 0, 0 },
+
+  // Start the layers one by one, turning speed to 0.3x while each is held
+  { 5000, Gesture::kPad, 3, 1 },
+  { 5100, Gesture::kKnob, 0, 639 },
+  { 5500, Gesture::kPad, 3, 0 },
+  { 5600, Gesture::kKnob, 0, 1023 },
+
+  { 7000, Gesture::kPad, 5, 1 },
+  { 7100, Gesture::kKnob, 0, 639 },
+  { 7500, Gesture::kPad, 5, 0 },
+  { 7600, Gesture::kKnob, 0, 1023 },
+
+  { 9000, Gesture::kPad, 7, 1 },
+  { 9100, Gesture::kKnob, 0, 639 },
+  { 9500, Gesture::kPad, 7, 0 },
+
+  // Reverb mix with P10
+  { 10000, Gesture::kPad, 10, 1 },
+  { 10100, Gesture::kKnob, 5, 600 },
+  { 10500, Gesture::kPad, 10, 0 },
+
+  // Play for 30 seconds
+  { 40000, Gesture::kKnob, 5, 600 }
+};
+
+static constexpr size_t kScriptLength = sizeof(kScript) / sizeof(Gesture);
+
+};
@@ -43,6 +43,10 @@ class Touch {
       _on_release = on_release;
     }
 
+    uint16_t State() {
+      return _state;
+    }
+
     bool IsTouched(uint16_t pad) {
       #ifdef V2_0
         pad = v1to2[pad]; 
@@ -55,10 +59,15 @@ class Touch {
     }
 
     void Process() {
+        Process(_cap.touched());
+    }
+
+    // Process a touch state supplied from elsewhere,
+    // e.g. a gesture player. Bit N is pad N.
+    void Process(const uint16_t state) {
         uint16_t pad;
         bool is_touched;
         bool was_touched;
-        auto state = _cap.touched();
         for (uint16_t i = 0; i < 12; i++) {
           pad = 1 << i;
           is_touched = state & pad;
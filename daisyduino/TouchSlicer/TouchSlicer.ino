@@ -1,7 +1,12 @@
 // SYNTHUX ACADEMY /////////////////////////////////////////
 // SLICER //////////////////////////////////////////////////
 
+// Uncomment to count heap allocations and
+// blocking calls made in the audio callback.
+// #define RT_GUARD
+
 #include "simple-daisy-touch.h"
+#include "rtguard.h"
 #include "aknob.h"
 #include "trig.h"
 #include "gen.h"
@@ -59,6 +64,9 @@ static synthux::CPattern ptn;
 static synthux::Trigger<kPPQN> trig;
 static synthux::TrigArp<kPadsUsed> arp;
 static synthux::Clock<kPPQN> clk;
+#ifdef EXTERNAL_SYNC
+static synthux::ClockIn<> clock_in;
+#endif
 
 ///////////////////////////////////////////////////////////////
 ///////////////////////// CALLBACKS ///////////////////////////
@@ -81,14 +89,27 @@ void OnRelease(uint16_t pad) {
   }
 }
 
+#ifdef EXTERNAL_SYNC
+// Pin interrupt, keep it short.
+void OnClockEdge() {
+  clock_in.Capture();
+}
+#endif
+
 ///////////////////////////////////////////////////////////////
 ///////////////////// AUDIO CALLBACK //////////////////////////
 bool is_recording = false;
 
 void AudioCallback(float **in, float **out, size_t size) {
+  synthux::RTGuard::Scope rt_guard;
   auto out0 = 0.f;
   auto out1 = 0.f;
 
+  #ifdef EXTERNAL_SYNC
+  uint32_t edge;
+  while (clock_in.Pop(edge)) clk.Sync(edge, micros());
+  #endif
+
   clk.Tick();
 
   for (size_t i = 0; i < size; i++) {
@@ -158,7 +179,7 @@ void setup() {
   clk.Init(sample_rate, buffer_size);
   clk.SetOnTick(OnClockTick);
   #ifdef EXTERNAL_SYNC
-  pinMode(clk_pin, INPUT);
+  clock_in.Init(clk_pin, OnClockEdge);
   #endif
 
   // BEGIN CALLBACK
@@ -198,11 +219,6 @@ void loop() {
   auto tempo = speed_knob.Process();
   clk.SetTempo(tempo);
 
-  //Sync
-  #ifdef EXTERNAL_SYNC
-  clk.Process(!digitalRead(clk_pin));
-  #endif
-
   //Pitch
   auto pitch_val = pitch_fader.Process();
   if (pitch_val < 0.45 || pitch_val > 0.55) {
@@ -228,5 +244,7 @@ void loop() {
   bool as_played = !(is_forward || is_backward);
   arp.SetAsPlayed(as_played);
 
+  synthux::RTGuard::Report();
+
   delay(4);
 }
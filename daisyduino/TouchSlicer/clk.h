@@ -1,8 +1,12 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <stdint.h>
 
+#include "clkin.h"
+#include "transport.h"
+
 namespace synthux {
 
 static constexpr float kBPMMin = 40;
@@ -22,29 +26,30 @@ public:
       _on_tick             { nullptr },
       _is_running          { false },
       _is_about_to_run     { false },
-      _tr_time             { 0 },
+      _block_size          { 0 },
       _ticks_per_clock     { ppqn / 4 },
       _ticks               { 0 },
-      _fticks              { 0 },
       _ticks_at_last_clock { 0 },
       _tempo_ticks         { 0 },
       _hold                { false },
       _resync              { false },
       _manual_tempo        { 120 },
       _raw_manual_tempo    { 120 },
-      _tempo_mks           { 500000 },
-      _last_state          { 1 } 
+      _last_state          { 1 },
+      _reset_pending       { false }
       {}
     
     ~Clock() = default;
 
     void Init(float sample_rate, float buffer_size) {
-        auto interval = 1e6 * buffer_size / sample_rate;
-        _tr_time = ppqn * interval;
+        _transport.Init(static_cast<uint32_t>(sample_rate));
+        _transport.SetTempo(_manual_tempo);
+        _block_size = static_cast<uint32_t>(buffer_size);
     }
 
     // Called by internal interrupt timer (audio callback in this implementation).
     void Tick() {
+        apply_reset();
         if (!_is_running) return;
         emit_ticks();
     }
@@ -63,7 +68,29 @@ public:
         _last_state = state;
     }
     
-    float Tempo() { return 60000000.f / _tempo_mks; }
+    /*
+    External clock edge captured by ClockIn, in micros().
+    Call from the audio callback before Tick(), with the current
+    time. The PLL smooths the edge jitter out and sets the tempo,
+    the timeline is resynced to the filtered edge and the ticks
+    due since then go out with the next Tick().
+    */
+    void Sync(uint32_t edge_us, uint32_t now_us) {
+        apply_reset();
+        if (!external_clock()) return;
+        if (!_pll.Process(edge_us)) return;
+        external_clock_tick();
+        if (!_pll.IsLocked() || !_is_running) return;
+        _transport.SetBeatLength(_pll.Period() * 4);
+        auto elapsed = static_cast<int32_t>(now_us - _pll.Edge());
+        if (elapsed > 0 && elapsed < _pll.Period()) _transport.Resync(elapsed);
+    }
+
+    float Tempo() { return _transport.Tempo(); }
+
+    // Timeline position since Run().
+    Position CurrentPosition() { return _transport.At(_ticks); }
+
     /*
     Setting tempo from internal control. 
     Has no effect in case of syncing to extrnal clock.
@@ -73,7 +100,7 @@ public:
         _raw_manual_tempo = norm_value;
         const auto clock_off_offset = 10;
         _manual_tempo = (kBPMRange - clock_off_offset) * norm_value + kBPMMin - clock_off_offset;
-        _tempo_mks = tempo_mks(_manual_tempo);
+        _transport.SetTempo(_manual_tempo);
         if (external_clock()) {
             if (_is_running) {
                 _is_running = false;
@@ -83,7 +110,7 @@ public:
                 _is_running = true;
                 _is_about_to_run = false;
             }
-            reset();
+            request_reset();
         }
     }
 
@@ -100,7 +127,7 @@ public:
 
     void Stop() {
       _is_running = false;
-      reset();
+      request_reset();
     }
     bool IsRunning() { return _is_running; };
 
@@ -132,12 +159,11 @@ private:
     This method generates internal ticks and also synchronises to the external clock.
     So it's called both from internal interrupt timer (audio callback in this implementation) and upon external clock tick reception.
     nticks - integer count of internal ticks
-    _fticks - fractional count of internal ticks
     _tempo_ticks - integer ticks count since last external clock
-    _tempo_mks - tempo in microseconds / beat (quarter note)
+    _transport - tempo, and the sub-tick phase as an exact fraction of a tick
     _resync - flag to resync to external clock. Is set to true once external clock tick is received.
     _hold - flag to stop advancing internal timeline if the number of internal ticks exceeded expected count of internal ticks per extrnal tick
-    _tr_time - internal resolution (ppqn) multiplied by interrupt interval.
+    _block_size - samples per interrupt (audio block).
     */
     void emit_ticks() {
         uint32_t nticks = 0;
@@ -147,8 +173,7 @@ private:
         //in order to calculate and correct the tempo.
         //This flag is set to false upon reception of the external tick.
         if (_hold) {
-            nticks = (_fticks + _tr_time) / _tempo_mks;
-            _fticks += _tr_time - (nticks * _tempo_mks);
+            nticks = _transport.Advance(_block_size);
             _tempo_ticks += nticks;
             return;
         }
@@ -157,17 +182,19 @@ private:
         //we do resync, i.e. align inernal timeline with the external one
         //and adjust tempo.
         if (_resync) {
-            _fticks = 0;
+            //Catching up, the ticks are due now.
+            _transport.Resync();
             nticks = _ticks_per_clock - (_ticks - _ticks_at_last_clock);
             _ticks_at_last_clock = _ticks + nticks;
-            _tempo_mks -= ((int32_t)_ticks_per_clock - (int32_t)_tempo_ticks) * (int32_t)_tempo_mks / (int32_t)ppqn;
+            // Beat length scaled by (ppqn - missing) / ppqn
+            auto beat = (int64_t)ppqn - ((int64_t)_ticks_per_clock - (int64_t)_tempo_ticks);
+            if (beat > 0) _transport.SetMilliBPM((uint64_t)_transport.MilliBPM() * ppqn / beat);
             _tempo_ticks = 0;
             _resync = false;
         }
         //Regular mode. We generate internal ticks.
         else {
-            nticks = (_fticks + _tr_time) / _tempo_mks;
-            _fticks += _tr_time - nticks * _tempo_mks;
+            nticks = _transport.Advance(_block_size);
             if (external_clock()) {
                 _tempo_ticks += nticks;
                 //If there are more internal ticks per the external tick than 
@@ -189,8 +216,23 @@ private:
         }
     }
     
+    /*
+    SetTempo() and Stop() run in loop(), while the callback is
+    using the PLL, the timeline and the tick counts. They only
+    raise a flag, the callback does the reset before it touches
+    any of them again.
+    */
+    void request_reset() {
+        _reset_pending.store(true, std::memory_order_release);
+    }
+
+    void apply_reset() {
+        if (_reset_pending.exchange(false, std::memory_order_acq_rel)) reset();
+    }
+
     void reset() {
-         _fticks = 0;
+        _pll.Reset();
+        _transport.Reset();
         _ticks = 0;
         _ticks_at_last_clock = 0;
         _tempo_ticks = 0;
@@ -198,29 +240,26 @@ private:
         _resync = false;
     }
     
-    uint32_t tempo_mks(const float tempo) {
-        return static_cast<uint32_t>(60.f * 1e6 / tempo);
-    }
-
     void(*_on_tick)();
 
     bool _is_running;
     bool _is_about_to_run;
 
-    uint32_t _tr_time;
+    uint32_t _block_size;
     uint32_t _ticks_per_clock;
-    uint32_t _ticks;
-    uint32_t _fticks;
-    uint32_t _ticks_at_last_clock;
+    uint64_t _ticks;
+    uint64_t _ticks_at_last_clock;
     uint32_t _tempo_ticks;
     bool _hold;
     bool _resync;
 
     float _manual_tempo;
     float _raw_manual_tempo;
-    uint32_t _tempo_mks;
 
     int _last_state;
+    ClockPll _pll;
+    Transport<ppqn> _transport;
+    std::atomic<bool> _reset_pending;
 };
 
 };
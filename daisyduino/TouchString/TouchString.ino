@@ -1,17 +1,29 @@
 // SYNTHUX ACADEMY /////////////////////////////////////////
 // ARPEGGIATED STRING //////////////////////////////////////
 
+// Uncomment to count heap allocations and
+// blocking calls made in the audio callback.
+// #define RT_GUARD
+
+// Uncomment to play the lighter Karplus-Strong
+// string instead of DaisySP StringVoice.
+// #define KS_STRING
+
 #include "simple-daisy-touch.h"
-#include "clk.h"
+#include "rtguard.h"
 #include "aknob.h"
-#include "vox.h"
-#include "arp.h"
-#include "scale.h"
-#include "cpattern.h"
-#include "trigger.h"
 #include "onoffon.h"
 #include "mvalue.h"
-#include "xfade.h"
+#include "arpstring.h"
+
+// Uncomment to sweep the string voice parameters
+// at startup and print a brightness limit table
+// for vox.h over Serial. Audio starts after it.
+// #define STABILITY_SWEEP
+
+#ifdef STABILITY_SWEEP
+#include "sweep.h"
+#endif
 
 using namespace synthux;
 
@@ -20,7 +32,6 @@ using namespace synthux;
 
 static const uint8_t kAnalogResolution = 7; //7bits => 0..127
 static const uint8_t kNotesCount = 8;
-static const uint8_t kPPQN = 24;
 static const uint16_t kFirstNotePad = 3;
 
 ////////////////////////////////////////////////////////////
@@ -62,181 +73,67 @@ static const int clk_pin = D(S31);
 
 ////////////////////////////////////////////////////////////
 //////////////////////// MODULES ///////////////////////////
+#ifdef EXTERNAL_SYNC
+static ClockIn<> clock_in;
+#endif
 
-static Scale scale;
 static simpletouch::Touch touch;
-static Clock<kPPQN> clck;
-static Trigger<kPPQN> trig;
-static CPattern pattern;
-static Arp<kNotesCount, 4> arp;
-static Vox vox;
-static Overdrive drv;
-static ReverbSc verb;
-static XFade xfade;
+static ArpString arp_string;
+
+#ifdef STABILITY_SWEEP
+static StabilitySweep sweep;
+#endif
 
 ////////////////////////////////////////////////////////////
 ////////////////////////// STATE ///////////////////////////
 
-std::array<bool, kNotesCount> hold;
 auto is_to_touched = false;
 auto is_ch_touched = false;
-auto latch = false;
-auto tempo = .45f;
-auto arp_on = false;
-auto scale_index = 0;
-auto volume = 1.f;
-
-////////////////////////////////////////////////////////////
-////////////////////// HUMANIZE ////////////////////////////
-
-std::default_random_engine _rand_engine;
-std::uniform_int_distribution<uint8_t> dice(0, 100);
-
-uint8_t human_note_chance; //0...100
-float humanized_note(uint8_t note) {
-  auto freq = scale.FreqAt(note);
-  if (human_note_chance <= 2) return freq;
-  auto human_note_chance_dice = dice(_rand_engine);
-  auto note_dice = dice(_rand_engine);
-  auto octave_dice = dice(_rand_engine);
-  if (human_note_chance < 33) {
-    if (human_note_chance_dice < human_note_chance) {
-      return (octave_dice < 50) ? freq * .5f : freq * 2.f;
-    }
-    else return freq;
-  }
-  else if (human_note_chance < 66) {
-    if (human_note_chance_dice < human_note_chance) {
-      if (note_dice < 50) freq = scale.Random();
-      if (octave_dice < 25) return freq * .5f;
-      else if (octave_dice > 75) return freq * 2.f; 
-    }
-    else return freq;
-  }
-  else {
-    if (note_dice < human_note_chance) freq = scale.Random();
-    if (octave_dice < 20) return freq * 2.f;
-    else if (octave_dice > 80) return freq * .5f;
-    else return freq; //60% of freq passes through unchanged
-  }
-}
-
-float brightness;
-float structure;
-float damping;
-uint8_t human_string_chance;
-void humanize_string() {
-  if (human_string_chance > 2) {
-    auto chance_dice = dice(_rand_engine);
-    if (chance_dice < human_string_chance) {
-      auto bright_dice = dice(_rand_engine);
-      auto structure_dice = dice(_rand_engine);
-      auto damping_dice = dice(_rand_engine);
-
-      auto bright_delta = bright_dice * 0.002f;
-      brightness = std::min(brightness + bright_delta, 1.f);
-
-      auto struct_delta = structure_dice * 0.002f;
-      structure = std::min(structure + struct_delta, 1.f);
-
-      auto damping_delta = damping_dice * 0.004f;
-      damping = std::min(damping + damping_delta, 1.f);
-    }
-  }
-  vox.SetBrightness(brightness);
-  vox.SetStructure(structure);
-  vox.SetDamping(damping);
-}
 
 ////////////////////////////////////////////////////////////
 ///////////////////// CALLBACKS ////////////////////////////
 void OnPadTouch(uint16_t pad) {
   // Scale & Tempo
   if (pad == 0) {
-    if (is_to_touched) tempo = max(tempo - .05f, 0.05f);
-    else if (is_ch_touched) {
-      scale_index = max(0, --scale_index);
-      scale.SetScaleIndex(scale_index);
-    }
+    if (is_to_touched) arp_string.SlowDown();
+    else if (is_ch_touched) arp_string.PrevScale();
     return;
   }
   if (pad == 2) {
-    if (is_to_touched) tempo = min(tempo + .05f, 1.f);
-    else if (is_ch_touched) { 
-      scale_index = min(scale.ScalesCount() - 1, ++scale_index);
-      scale.SetScaleIndex(scale_index);
-    }
+    if (is_to_touched) arp_string.SpeedUp();
+    else if (is_ch_touched) arp_string.NextScale();
     return;
   }
 
   // Notes
   if (pad < kFirstNotePad || pad >= kFirstNotePad + kNotesCount - 1) return;
-  auto note_num = pad - kFirstNotePad;
-  if (!arp_on) {
-    humanize_string();
-    vox.NoteOn(scale.FreqAt(note_num), 1.f);
-    return;
-  }
-
-  if (arp_on && latch && hold[note_num]) {
-    arp.NoteOff(note_num);
-    hold[note_num] = false;
-  }
-  else {
-      arp.NoteOn(note_num, 127);
-      hold[note_num] = true;
-  }
-
-  if (arp.HasNote()) {
-    if (!clck.IsRunning()) clck.Run();
-  }
-  else {
-    Reset();
-  }
+  arp_string.NoteOn(pad - kFirstNotePad);
 }
+
 void OnPadRelease(uint16_t pad) {
   if (pad < kFirstNotePad || pad >= kFirstNotePad + kNotesCount) return;
-  auto num = pad - kFirstNotePad;
-  if (!latch) { 
-    arp.NoteOff(num);
-    hold[num] = false;
-  }
-  if (!arp.HasNote()) {
-    Reset();
-  }
-}
-void Reset() {
-  clck.Stop();
-  trig.Reset();
-  pattern.Reset();
-  arp.Clear();
-}
-
-void OnArpNoteOn(uint8_t num, uint8_t vel) {
-  auto freq = arp_on ? humanized_note(num) : scale.FreqAt(num);
-  humanize_string();
-  vox.NoteOn(freq, 1.f);
+  arp_string.NoteOff(pad - kFirstNotePad);
 }
-void OnArpNoteOff(uint8_t num) {}
 
-void OnClockTick() { 
-  if (trig.Tick() && pattern.Tick()) arp.Trigger();
+///////////////////////////////////////////////////////////////
+////////////////////// CLOCK CALLBACKS ////////////////////////
+#ifdef EXTERNAL_SYNC
+// Pin interrupt, keep it short.
+void OnClockEdge() {
+  clock_in.Capture();
 }
+#endif
 
 ///////////////////////////////////////////////////////////////
 ///////////////////// AUDIO CALLBACK //////////////////////////
-float verb_in[2];
-float verb_out[2];
-float bus[2];
 void AudioCallback(float **in, float **out, size_t size) {
-  clck.Tick();
-  for (size_t i = 0; i < size; i++) {
-    bus[0] = bus[1] = drv.Process(vox.Process()) * volume;
-    xfade.Process(0, 0, bus[0], bus[1], verb_in[0], verb_in[1]);
-    verb.Process(verb_in[0], verb_in[1], &(verb_out[0]), &(verb_out[1]));
-    out[0][i] = (bus[0] + verb_out[0]) * .75f;
-    out[1][i] = (bus[1] + verb_out[1]) * .75f;
-  }
+  RTGuard::Scope rt_guard;
+  #ifdef EXTERNAL_SYNC
+  uint32_t edge;
+  while (clock_in.Pop(edge)) arp_string.SyncClockIn(edge, micros());
+  #endif
+
+  arp_string.Process(out, size);
 }
 
 ///////////////////////////////////////////////////////////////
@@ -248,29 +145,21 @@ void setup() {
   float sample_rate = DAISY.AudioSampleRate();
   float buffer_size = DAISY.AudioBlockSize();
 
-  clck.Init(sample_rate, buffer_size);
-  clck.SetOnTick(OnClockTick);
+  #ifdef STABILITY_SWEEP
+  sweep.Run(sample_rate, buffer_size);
+  #endif
+
+  arp_string.Init(sample_rate, buffer_size);
 
   #ifdef EXTERNAL_SYNC
-  pinMode(clk_pin, INPUT);
+  clock_in.Init(clk_pin, OnClockEdge);
   #endif
 
   touch.Init();
   touch.SetOnTouch(OnPadTouch);
   touch.SetOnRelease(OnPadRelease);
 
-  arp.SetOnNoteOn(OnArpNoteOn);
-  arp.SetOnNoteOff(OnArpNoteOff);
-  
-  vox.Init(sample_rate);
-
-  drv.Init();
-
   arp_mode_switch.Init();
-  
-  verb.Init(sample_rate);
-  verb.SetFeedback(0.8);
-  verb.SetLpFreq(10000.f);
 
   pattern_value.Init(1.f);
   shift_value.Init(0.f);
@@ -286,12 +175,7 @@ void setup() {
 ////////////////////////// LOOP ///////////////////////////////
 
 void loop() {
-  clck.SetTempo(tempo);
-  #ifdef EXTERNAL_SYNC
-  clck.Process(!digitalRead(clk_pin));
-  #endif
-
-  digitalWrite(LED_BUILTIN, latch);
+  digitalWrite(LED_BUILTIN, arp_string.IsLatched());
 
   touch.Process();
 
@@ -299,30 +183,18 @@ void loop() {
   is_ch_touched = touch.IsTouched(11); 
 
   auto arp_mode_value = arp_mode_switch.Value();
-  arp_on = arp_mode_value > 0;
-  auto new_latch = arp_mode_value > 1;
-  if (latch && !new_latch) {
-      //Drop all latched notes except ones being touched
-      for (auto i = 0; i < hold.size(); i++) {
-        if (hold[i] && !touch.IsTouched(i + kFirstNotePad))  {
-          arp.NoteOff(i);
-        }
-      }
-      //Reset latch memory
-      hold.fill(false);
-  }
-  latch = new_latch;
-  arp.SetDirection(ArpDirection::fwd);
-  arp.SetRandChance(0);
-  arp.SetAsPlayed(true);
+  arp_string.SetArpOn(arp_mode_value > 0);
+  arp_string.SetLatch(arp_mode_value > 1, [](uint8_t note) {
+    return touch.IsTouched(note + kFirstNotePad);
+  });
 
-  vox.SetMult(scale.TransMult(transp_knob.Process()));
+  arp_string.SetTransposition(transp_knob.Process());
   
-  damping = damp_fader.Process();
-  structure = struct_knob.Process();
-  brightness = bright_knob.Process();
+  arp_string.SetDamping(damp_fader.Process());
+  arp_string.SetStructure(struct_knob.Process());
+  arp_string.SetBrightness(bright_knob.Process());
   
-  human_note_chance = fmap(human_notes_knob.Process(), 0, 100);
+  arp_string.SetHumanNoteChance(human_notes_knob.Process());
 
   auto human_verb_knob_value = human_verb_knob.Process();
   verb_value.SetActive(is_to_touched, human_verb_knob_value);
@@ -341,17 +213,18 @@ void loop() {
     pattern_value.Process(pattern_shift_value);
   }
 
-  human_string_chance = fmap(human_string_value.Value(), 0, 100);
+  arp_string.SetHumanStringChance(human_string_value.Value());
   
-  pattern.SetOnsets(pattern_value.Value());
-  pattern.SetShift(shift_value.Value());
+  arp_string.SetPattern(pattern_value.Value());
+  arp_string.SetPatternShift(shift_value.Value());
+
+  arp_string.SetReverbMix(verb_value.Value());
 
-  xfade.SetStage(verb_value.Value());
+  arp_string.SetDrive(vol_drive_fader.Process());
+  arp_string.Recover();
 
-  auto drive = vol_drive_fader.Process();
-  drv.SetDrive(0.2f  + drive * .4f);
-  volume = 1.f - drive * 0.6;
-  volume *= volume;
+  arp_string.ReportSentinels();
+  RTGuard::Report();
 
   delay(4);
-}
\ No newline at end of file
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 
 namespace synthux {
 
@@ -90,12 +91,12 @@ namespace synthux {
     }
 
     // Register note on callback
-    void SetOnNoteOn(void(*on_note_on)(uint8_t num, uint8_t vel)) {
+    void SetOnNoteOn(std::function<void(uint8_t num, uint8_t vel)> on_note_on) {
       _on_note_on = on_note_on;
     }
 
     // Register note off callback
-    void SetOnNoteOff(void(*on_note_off)(uint8_t num)) {
+    void SetOnNoteOff(std::function<void(uint8_t num)> on_note_off) {
       _on_note_off = on_note_off;
     }
 
@@ -239,8 +240,8 @@ namespace synthux {
     static const uint8_t kEmpty    = 0xfe;
     static const uint8_t kUnlinked = 0xfd;
 
-    void(*_on_note_on)(uint8_t num, uint8_t vel);
-    void(*_on_note_off)(uint8_t num);
+    std::function<void(uint8_t num, uint8_t vel)> _on_note_on;
+    std::function<void(uint8_t num)> _on_note_off;
 
     Note _notes[note_count + 1];
     uint8_t _input_order[note_count];
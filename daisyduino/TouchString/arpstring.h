@@ -0,0 +1,485 @@
+// SYNTHUX ACADEMY /////////////////////////////////////////
+// ARPEGGIATED STRING //////////////////////////////////////
+#pragma once
+#include <array>
+#include <atomic>
+#include <random>
+
+#include "DaisyDSP.h"
+
+#include "clk.h"
+#include "trigger.h"
+#include "cpattern.h"
+#include "arp.h"
+#include "scale.h"
+#ifdef KS_STRING
+#include "ksvox.h"
+#else
+#include "vox.h"
+#endif
+#include "xfade.h"
+#include "sentinel.h"
+#include "driver.h"
+#include "governor.h"
+#include "shaper.h"
+
+namespace synthux {
+
+class ArpString {
+public:
+  #ifdef KS_STRING
+  using StringVox = KSVox;
+  #else
+  using StringVox = Vox;
+  #endif
+
+  ArpString():
+  _voice_sentinel       { _sentinels, "voice" },
+  _reverb_sentinel      { _sentinels, "reverb" },
+  _master_sentinel      { _sentinels, "master" },
+  _dice                 { std::uniform_int_distribution<uint8_t>(0, 100) },
+  _tempo                { .45f },
+  _volume               { 1.f },
+  _brightness           { 0.f },
+  _structure            { 0.f },
+  _damping              { 0.f },
+  _human_note_chance    { 0 },
+  _human_string_chance  { 0 },
+  _scale_index          { 0 },
+  _is_arp_on            { false },
+  _is_latched           { false },
+  _posted_latch         { false },
+  _inbox_head           { 0 },
+  _inbox_tail           { 0 }
+  {
+    _verb_in.fill(0);
+    _verb_out.fill(0);
+    _bus.fill(0);
+    _hold.fill(false);
+  }
+
+  ~ArpString() {}
+
+  void Init(const float sample_rate, const float buffer_size) {
+    _sample_rate = sample_rate;
+
+    _clock.Init(sample_rate, buffer_size);
+    _clock.SetOnTick([this]() { _on_clock_tick(); });
+    SetTempo(_tempo);
+
+    _arp.SetOnNoteOn([this](uint8_t num, uint8_t vel) { _on_arp_note_on(num, vel); });
+    _arp.SetOnNoteOff([this](uint8_t num) { _driver.NoteOff(num); });
+    _arp.SetDirection(ArpDirection::fwd);
+    _arp.SetRandChance(0);
+    _arp.SetAsPlayed(true);
+
+    _driver.SetOnNoteOn([this](uint8_t vox_idx, uint8_t num, bool retrigger) {
+      _on_driver_note_on(vox_idx, num);
+    });
+    _driver.SetOnNoteOff([this](uint8_t vox_idx) { });
+
+    for (auto& v: _voices) {
+      v.Init(sample_rate);
+    }
+    _governor.Init(sample_rate, buffer_size);
+
+    _drv.Init();
+
+    _init_reverb();
+  }
+
+  void SetTempo(const float tempo) {
+    _clock.SetTempo(tempo);
+  }
+
+  void SpeedUp() {
+    _tempo = std::min(_tempo + .05f, 1.f);
+    SetTempo(_tempo);
+  }
+
+  void SlowDown() {
+    _tempo = std::max(_tempo - .05f, 0.05f);
+    SetTempo(_tempo);
+  }
+
+  // Edge timestamp from ClockIn, call before Process().
+  void SyncClockIn(const uint32_t edge_us, const uint32_t now_us) {
+    _clock.Sync(edge_us, now_us);
+  }
+
+  void NextScale() {
+    _scale_index = std::min(static_cast<uint8_t>(_scale.ScalesCount() - 1), ++_scale_index);
+    _scale.SetScaleIndex(_scale_index);
+  }
+
+  void PrevScale() {
+    if (_scale_index == 0) return;
+    _scale_index--;
+    _scale.SetScaleIndex(_scale_index);
+  }
+
+  void SetArpOn(const bool value) {
+    _is_arp_on = value;
+  }
+
+  bool IsLatched() {
+    return _posted_latch;
+  }
+
+  // Pad events from loop() go through a lock-free single producer
+  // inbox and are applied at the top of the next Process(), so the
+  // arp, driver and governor are only ever touched by the callback.
+  // They return false if the inbox is full and the event was dropped.
+
+  // is_touched(note) tells if the pad of the note is held down.
+  template<typename IsTouched>
+  bool SetLatch(const bool latch, const IsTouched& is_touched) {
+    if (latch == _posted_latch) return true;
+    uint8_t touched = 0;
+    for (uint8_t i = 0; i < kNotesCount; i++) {
+      if (is_touched(i)) touched |= 1 << i;
+    }
+    if (!_post({ latch ? PadEvent::Type::latch_on : PadEvent::Type::latch_off, 0, touched })) return false;
+    _posted_latch = latch;
+    return true;
+  }
+
+  bool NoteOn(const uint8_t note) {
+    return _post({ PadEvent::Type::note_on, note, 0 });
+  }
+
+  bool NoteOff(const uint8_t note) {
+    return _post({ PadEvent::Type::note_off, note, 0 });
+  }
+
+  void Reset() {
+    _clock.Stop();
+    _trigger.Reset();
+    _pattern.Reset();
+    _arp.Clear();
+  }
+
+  void SetTransposition(const float value) {
+    auto mult = _scale.TransMult(value);
+    for (auto& v: _voices) v.SetMult(mult);
+  }
+
+  // String parameters are applied on the next note.
+  void SetBrightness(const float value) {
+    _brightness = value;
+  }
+
+  void SetStructure(const float value) {
+    _structure = value;
+  }
+
+  void SetDamping(const float value) {
+    _damping = value;
+  }
+
+  void SetHumanNoteChance(const float value) {
+    _human_note_chance = fmap(value, 0, 100);
+  }
+
+  void SetHumanStringChance(const float value) {
+    _human_string_chance = fmap(value, 0, 100);
+  }
+
+  void SetPattern(const float value) {
+    _pattern.SetOnsets(value);
+  }
+
+  void SetPatternShift(const float value) {
+    _pattern.SetShift(value);
+  }
+
+  void SetReverbMix(const float value) {
+    _xfade.SetStage(value);
+  }
+
+  void SetDrive(const float value) {
+    _drv.SetDrive(0.2f + value * .4f);
+    _volume = 1.f - value * 0.6;
+    _volume *= _volume;
+  }
+
+  void Process(float **out, size_t size) {
+    _governor.Begin();
+    _drain_inbox();
+    _clock.Tick();
+    _peaks.fill(0.f);
+    auto is_reverb_on = !_reverb_reset.IsPending();
+    float voices;
+    for (size_t i = 0; i < size; i++) {
+      voices = 0.f;
+      for (uint8_t k = 0; k < kVoxCount; k++) {
+        if (!_governor.IsSounding(k)) continue;
+        auto v = _voices[k].Process() * _governor.Gain(k);
+        _peaks[k] = std::max(_peaks[k], fabsf(v));
+        voices += v * kVoxGain;
+      }
+      _bus[0] = _bus[1] = _drv.Process(_voice_sentinel.Watch(voices)) * _volume;
+      if (is_reverb_on) {
+        _xfade.Process(0, 0, _bus[0], _bus[1], _verb_in[0], _verb_in[1]);
+        _reverb.Process(_verb_in[0], _verb_in[1], &(_verb_out[0]), &(_verb_out[1]));
+        _reverb_sentinel.Watch(_verb_out[0]);
+        _reverb_sentinel.Watch(_verb_out[1]);
+      }
+      out[0][i] = _master_sentinel.Watch((_bus[0] + _verb_out[0]) * .75f);
+      out[1][i] = _master_sentinel.Watch((_bus[1] + _verb_out[1]) * .75f);
+    }
+    _check_sentinels(out, size);
+    for (uint8_t k = 0; k < kVoxCount; k++) {
+      _governor.Track(k, _peaks[k]);
+    }
+    _governor.End();
+  }
+
+  // Call from loop(). Finishes the resets
+  // too heavy for the audio callback.
+  void Recover() {
+    _reverb_reset.Run([this] { _init_reverb(); });
+  }
+
+  // Call from loop(). Prints the sentinels that tripped.
+  void ReportSentinels() {
+    _sentinels.Report();
+  }
+
+private:
+  struct PadEvent {
+    enum class Type: uint8_t {
+      note_on,
+      note_off,
+      latch_on,
+      latch_off
+    };
+    Type type;
+    uint8_t note;
+    // Pads held down when the latch changes, one bit per note.
+    uint8_t touched;
+  };
+
+  void _note_on(const uint8_t note) {
+    if (!_is_arp_on) {
+      _driver.NoteOn(note);
+      return;
+    }
+
+    if (_is_latched && _hold[note]) {
+      _arp.NoteOff(note);
+      _hold[note] = false;
+    }
+    else {
+      _arp.NoteOn(note, 127);
+      _hold[note] = true;
+    }
+
+    if (_arp.HasNote()) {
+      if (!_clock.IsRunning()) _clock.Run();
+    }
+    else {
+      Reset();
+    }
+  }
+
+  void _note_off(const uint8_t note) {
+    if (!_is_arp_on) _driver.NoteOff(note);
+    if (!_is_latched) {
+      _arp.NoteOff(note);
+      if (note < kNotesCount) _hold[note] = false;
+    }
+    if (!_arp.HasNote()) {
+      Reset();
+    }
+  }
+
+  void _set_latch(const bool latch, const uint8_t touched) {
+    if (_is_latched && !latch) {
+      //Drop all latched notes except ones being touched
+      for (uint8_t i = 0; i < kNotesCount; i++) {
+        if (_hold[i] && !(touched & (1 << i))) _arp.NoteOff(i);
+      }
+      //Reset latch memory
+      _hold.fill(false);
+    }
+    _is_latched = latch;
+  }
+
+  bool _post(const PadEvent& event) {
+    auto head = _inbox_head.load(std::memory_order_relaxed);
+    auto next = (head + 1) & kInboxMask;
+    if (next == _inbox_tail.load(std::memory_order_acquire)) return false;
+    _inbox[head] = event;
+    _inbox_head.store(next, std::memory_order_release);
+    return true;
+  }
+
+  void _drain_inbox() {
+    auto tail = _inbox_tail.load(std::memory_order_relaxed);
+    auto head = _inbox_head.load(std::memory_order_acquire);
+    for (; tail != head; tail = (tail + 1) & kInboxMask) {
+      auto& event = _inbox[tail];
+      switch (event.type) {
+        case PadEvent::Type::note_on: _note_on(event.note); break;
+        case PadEvent::Type::note_off: _note_off(event.note); break;
+        case PadEvent::Type::latch_on: _set_latch(true, event.touched); break;
+        case PadEvent::Type::latch_off: _set_latch(false, event.touched); break;
+      }
+    }
+    _inbox_tail.store(tail, std::memory_order_release);
+  }
+
+  void _init_reverb() {
+    _reverb.Init(_sample_rate);
+    _reverb.SetFeedback(0.8);
+    _reverb.SetLpFreq(10000.f);
+  }
+
+  // Silent until Recover() has run the reset.
+  void _mute_reverb() {
+    _verb_out.fill(0.f);
+    _reverb_reset.Request();
+  }
+
+  // Resets whatever blew up in the last block.
+  // A master trip resets everything and mutes the block.
+  void _check_sentinels(float **out, size_t size) {
+    auto is_voice_bad = _voice_sentinel.Check();
+    auto is_reverb_bad = _reverb_sentinel.Check();
+    auto is_master_bad = _master_sentinel.Check();
+    if (is_voice_bad || is_master_bad) {
+      for (auto& v: _voices) v.Reset();
+    }
+    if (is_reverb_bad || is_master_bad) _mute_reverb();
+    if (is_master_bad) {
+      for (size_t i = 0; i < size; i++) {
+        out[0][i] = out[1][i] = 0.f;
+      }
+    }
+  }
+
+  void _on_clock_tick() {
+    if (_trigger.Tick() && _pattern.Tick()) _arp.Trigger();
+  }
+
+  void _on_arp_note_on(uint8_t num, uint8_t vel) {
+    _driver.NoteOn(num);
+  }
+
+  void _on_driver_note_on(uint8_t vox_idx, uint8_t num) {
+    auto freq = _is_arp_on ? _humanized_note(num) : _scale.FreqAt(num);
+    auto& v = _voices[vox_idx];
+    _humanize_string(v);
+    // Clear what's left of a stolen string before the pluck
+    if (_governor.IsStolen(vox_idx)) v.Reset();
+    _governor.NoteOn(vox_idx);
+    v.NoteOn(freq, 1.f);
+  }
+
+  float _humanized_note(uint8_t note) {
+    auto freq = _scale.FreqAt(note);
+    if (_human_note_chance <= 2) return freq;
+    auto human_note_chance_dice = _dice(_rand_engine);
+    auto note_dice = _dice(_rand_engine);
+    auto octave_dice = _dice(_rand_engine);
+    if (_human_note_chance < 33) {
+      if (human_note_chance_dice < _human_note_chance) {
+        return (octave_dice < 50) ? freq * .5f : freq * 2.f;
+      }
+      else return freq;
+    }
+    else if (_human_note_chance < 66) {
+      if (human_note_chance_dice < _human_note_chance) {
+        if (note_dice < 50) freq = _scale.Random();
+        if (octave_dice < 25) return freq * .5f;
+        else if (octave_dice > 75) return freq * 2.f;
+      }
+      else return freq;
+    }
+    else {
+      if (note_dice < _human_note_chance) freq = _scale.Random();
+      if (octave_dice < 20) return freq * 2.f;
+      else if (octave_dice > 80) return freq * .5f;
+      else return freq; //60% of freq passes through unchanged
+    }
+  }
+
+  void _humanize_string(StringVox& vox) {
+    if (_human_string_chance > 2) {
+      auto chance_dice = _dice(_rand_engine);
+      if (chance_dice < _human_string_chance) {
+        auto bright_dice = _dice(_rand_engine);
+        auto structure_dice = _dice(_rand_engine);
+        auto damping_dice = _dice(_rand_engine);
+
+        auto bright_delta = bright_dice * 0.002f;
+        _brightness = std::min(_brightness + bright_delta, 1.f);
+
+        auto struct_delta = structure_dice * 0.002f;
+        _structure = std::min(_structure + struct_delta, 1.f);
+
+        auto damping_delta = damping_dice * 0.004f;
+        _damping = std::min(_damping + damping_delta, 1.f);
+      }
+    }
+    vox.SetBrightness(_brightness);
+    vox.SetStructure(_structure);
+    vox.SetDamping(_damping);
+  }
+
+  static constexpr uint8_t kPPQN = 24;
+  static constexpr uint8_t kNotesCount = 8;
+  static constexpr size_t kInboxSize = 16;
+  static constexpr size_t kInboxMask = kInboxSize - 1;
+  static constexpr uint8_t kVoxCount = 4;
+  // -3 dB per voice, the drive stage soaks up the overlap
+  static constexpr float kVoxGain = .7f;
+
+  Scale             _scale;
+  Clock<kPPQN>      _clock;
+  Trigger<kPPQN>    _trigger;
+  CPattern          _pattern;
+  Arp<kNotesCount, 4> _arp;
+  std::array<StringVox, kVoxCount> _voices;
+  Driver<kVoxCount> _driver;
+  VoiceGovernor<kVoxCount> _governor;
+  Shaper<2>         _drv;
+  ReverbSc          _reverb;
+  XFade             _xfade;
+
+  Sentinel::Registry _sentinels;
+  Sentinel          _voice_sentinel;
+  Sentinel          _reverb_sentinel;
+  Sentinel          _master_sentinel;
+  DeferredReset     _reverb_reset;
+
+  std::default_random_engine _rand_engine;
+  std::uniform_int_distribution<uint8_t> _dice;
+
+  std::array<float, 2> _verb_in;
+  std::array<float, 2> _verb_out;
+  std::array<float, 2> _bus;
+  std::array<float, kVoxCount> _peaks;
+
+  float   _sample_rate;
+  float   _tempo;
+  float   _volume;
+  float   _brightness;
+  float   _structure;
+  float   _damping;
+  uint8_t _human_note_chance;
+  uint8_t _human_string_chance;
+  uint8_t _scale_index;
+
+  bool _is_arp_on;
+  bool _is_latched;
+  bool _posted_latch;
+  std::array<bool, kNotesCount> _hold;
+
+  std::array<PadEvent, kInboxSize> _inbox;
+  std::atomic<size_t> _inbox_head;
+  std::atomic<size_t> _inbox_tail;
+};
+
+};
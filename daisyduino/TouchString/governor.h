@@ -0,0 +1,163 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <math.h>
+#include <stdint.h>
+
+#include "load.h"
+
+namespace synthux {
+
+/**
+ * @brief
+ * CPU budget governor for a voice pool.
+ * Measures the audio callback load and caps the number of
+ * sounding voices: over kHighLoad the cap drops by one and the
+ * quietest voice is stolen, under kLowLoad it grows back.
+ * Stolen voices fade out over kFadeTime and must be cleared
+ * before they're replucked. Voices that decayed below kSilence
+ * go to sleep and cost nothing until replucked.
+ */
+template<uint8_t max_vox_count>
+class VoiceGovernor {
+public:
+  VoiceGovernor():
+    _hold         { 0 },
+    _fade_step    { 0.f },
+    _level_decay  { 0.f },
+    _load_avg     { 0.f },
+    _cap          { max_vox_count }
+    {
+      _state.fill(State::asleep);
+      _gain.fill(0.f);
+      _level.fill(0.f);
+      _is_stolen.fill(false);
+    }
+
+  void Init(const float sample_rate, const size_t block_size) {
+    _load.Init(sample_rate, block_size);
+    _hold_blocks = static_cast<uint32_t>(kHoldTime * sample_rate / block_size);
+    _fade_step = 1.f / (kFadeTime * sample_rate);
+    // -60 dB over kLevelRelease, whatever the block size
+    _level_decay = powf(.001f, block_size / (kLevelRelease * sample_rate));
+  }
+
+  // Call at the top of the audio callback...
+  void Begin() {
+    _load.Begin();
+  }
+
+  // ...and at the very end of it.
+  void End() {
+    _load.End();
+    _load_avg += kLoadSmoothing * (_load.Last() - _load_avg);
+    if (_hold > 0) {
+      _hold--;
+      return;
+    }
+    if (_load_avg > kHighLoad && _cap > 1) {
+      _cap--;
+      _enforce_cap(kNone);
+      _hold = _hold_blocks;
+    }
+    else if (_load_avg < kLowLoad && _cap < max_vox_count) {
+      _cap++;
+      _hold = _hold_blocks;
+    }
+  }
+
+  // The voice is about to be plucked.
+  void NoteOn(const uint8_t vox) {
+    _state[vox] = State::awake;
+    _gain[vox] = 1.f;
+    _level[vox] = 1.f;
+    _is_stolen[vox] = false;
+    _enforce_cap(vox);
+  }
+
+  // The voice was cut off mid ring since its last NoteOn(),
+  // its tail would come back on the next pluck.
+  bool IsStolen(const uint8_t vox) const {
+    return _is_stolen[vox];
+  }
+
+  bool IsSounding(const uint8_t vox) const {
+    return _state[vox] != State::asleep;
+  }
+
+  // Per sample gain of the voice, ramps stolen voices out.
+  float Gain(const uint8_t vox) {
+    if (_state[vox] == State::fading) {
+      _gain[vox] -= _fade_step;
+      if (_gain[vox] <= 0.f) {
+        _gain[vox] = 0.f;
+        _state[vox] = State::asleep;
+      }
+    }
+    return _gain[vox];
+  }
+
+  // Call once per block with the voice's peak output.
+  void Track(const uint8_t vox, const float peak) {
+    _level[vox] = std::max(peak, _level[vox] * _level_decay);
+    if (_state[vox] == State::awake && _level[vox] < kSilence) {
+      _state[vox] = State::asleep;
+    }
+  }
+
+  uint8_t Cap() const {
+    return _cap;
+  }
+
+  float Load() const {
+    return _load_avg;
+  }
+
+private:
+  enum class State {
+    asleep,
+    awake,
+    fading
+  };
+
+  void _enforce_cap(const uint8_t keep) {
+    uint8_t awake_count = 0;
+    for (auto i = 0; i < max_vox_count; i++) {
+      if (_state[i] == State::awake) awake_count++;
+    }
+    while (awake_count > _cap) {
+      uint8_t quietest = kNone;
+      for (uint8_t i = 0; i < max_vox_count; i++) {
+        if (i == keep || _state[i] != State::awake) continue;
+        if (quietest == kNone || _level[i] < _level[quietest]) quietest = i;
+      }
+      if (quietest == kNone) return;
+      _state[quietest] = State::fading;
+      _is_stolen[quietest] = true;
+      awake_count--;
+    }
+  }
+
+  static constexpr uint8_t kNone = 0xff;
+  static constexpr float kHighLoad = .75f;
+  static constexpr float kLowLoad = .5f;
+  static constexpr float kLoadSmoothing = .05f;
+  static constexpr float kHoldTime = .05f; // s
+  static constexpr float kFadeTime = .005f; // s
+  static constexpr float kLevelRelease = .1f; // s
+  static constexpr float kSilence = .0001f; // -80 dB
+
+  CpuLoad _load;
+  std::array<State, max_vox_count> _state;
+  std::array<float, max_vox_count> _gain;
+  std::array<float, max_vox_count> _level;
+  std::array<bool, max_vox_count> _is_stolen;
+  uint32_t _hold_blocks;
+  uint32_t _hold;
+  float _fade_step;
+  float _level_decay;
+  float _load_avg;
+  uint8_t _cap;
+};
+
+};
@@ -0,0 +1,160 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <math.h>
+#include <stdint.h>
+
+#include "DaisyDSP.h"
+
+namespace synthux {
+
+/**
+ * @brief
+ * Karplus-Strong string. A cheaper, always stable alternative
+ * to DaisySP StringVoice with the same control surface.
+ *
+ *   - Brightness: exciter noise colour and loop lowpass
+ *   - Structure: allpass dispersion in the loop (stiffness)
+ *   - Damping: decay time, from ~10 s down to ~0.1 s
+ *
+ * Every element in the loop has a gain of at most 1 and the loop
+ * gain is below 1, so no setting can make it run away.
+ * Coefficients are computed in the setters, not per sample.
+ */
+class KString {
+public:
+  KString():
+  _sample_rate  { 48000.f },
+  _freq         { 110.f },
+  _brightness   { .5f },
+  _structure    { 0.f },
+  _damping      { .5f },
+  _noise        { 1 }
+  {}
+  ~KString() {}
+
+  void Init(const float sample_rate) {
+    _sample_rate = sample_rate;
+    Reset();
+    _update_exciter();
+    _update_loop();
+  }
+
+  // Clears the string. Costs one pass over the delay line.
+  void Reset() {
+    _line.fill(0.f);
+    _write = 0;
+    _lp = 0.f;
+    _ap_in = 0.f;
+    _ap_out = 0.f;
+    _exciter_lp = 0.f;
+    _excite_left = 0;
+  }
+
+  void SetFreq(const float freq) {
+    _freq = freq;
+    _update_loop();
+  }
+
+  void SetBrightness(const float value) {
+    _brightness = fclamp(value, 0.f, 1.f);
+    _update_exciter();
+    _update_loop();
+  }
+
+  void SetStructure(const float value) {
+    _structure = fclamp(value, 0.f, 1.f);
+    _update_loop();
+  }
+
+  void SetDamping(const float value) {
+    _damping = fclamp(value, 0.f, 1.f);
+    _update_loop();
+  }
+
+  // Plucks the string with one period of filtered noise.
+  void Trig() {
+    _excite_left = _delay_int + 1;
+  }
+
+  float Process() {
+    auto in = 0.f;
+    if (_excite_left > 0) {
+      _excite_left--;
+      _exciter_lp += _exciter_coef * (_noise_sample() - _exciter_lp);
+      in = _exciter_lp * _exciter_gain;
+    }
+
+    auto a = _line[(_write - _delay_int) & kMask];
+    auto b = _line[(_write - _delay_int - 1) & kMask];
+    auto out = a + (b - a) * _delay_frac;
+
+    _lp += _lp_coef * (out - _lp);
+    auto ap = _ap_coef * (_lp - _ap_out) + _ap_in;
+    _ap_in = _lp;
+    _ap_out = ap;
+
+    _line[_write] = in + ap * _gain;
+    _write = (_write + 1) & kMask;
+    return out;
+  }
+
+private:
+  static constexpr size_t kLineSize = 4096;
+  static constexpr size_t kMask = kLineSize - 1;
+  static constexpr float kMaxDecay = 10.f;
+  static constexpr float kDecayRange = .01f;
+  static constexpr float kMaxGain = .99995f;
+
+  void _update_exciter() {
+    _exciter_coef = .05f + .95f * _brightness * _brightness;
+    // Keep the level of the filtered noise roughly constant
+    _exciter_gain = .25f * sqrtf((2.f - _exciter_coef) / _exciter_coef);
+  }
+
+  void _update_loop() {
+    _lp_coef = .25f + .75f * _brightness;
+    _ap_coef = -.7f * _structure;
+
+    // Low frequency delay of the loop filters, taken
+    // off the line so the string stays in tune.
+    auto filters_delay = (1.f - _lp_coef) / _lp_coef
+                       + (1.f - _ap_coef) / (1.f + _ap_coef);
+    auto delay = fclamp(_sample_rate / std::max(_freq, 1.f) - filters_delay, 1.f, kLineSize - 2.f);
+    _delay_int = static_cast<size_t>(delay);
+    _delay_frac = delay - static_cast<float>(_delay_int);
+
+    auto decay = kMaxDecay * powf(kDecayRange, _damping);
+    _gain = std::min(powf(.001f, 1.f / (std::max(_freq, 1.f) * decay)), kMaxGain);
+  }
+
+  float _noise_sample() {
+    _noise = _noise * 1664525u + 1013904223u;
+    return static_cast<float>(static_cast<int32_t>(_noise)) * (1.f / 2147483648.f);
+  }
+
+  std::array<float, kLineSize> _line;
+  size_t _write;
+  size_t _delay_int;
+  size_t _excite_left;
+  float _delay_frac;
+
+  float _sample_rate;
+  float _freq;
+  float _brightness;
+  float _structure;
+  float _damping;
+
+  float _gain;
+  float _lp_coef;
+  float _lp;
+  float _ap_coef;
+  float _ap_in;
+  float _ap_out;
+  float _exciter_coef;
+  float _exciter_gain;
+  float _exciter_lp;
+  uint32_t _noise;
+};
+
+};
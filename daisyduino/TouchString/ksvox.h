@@ -0,0 +1,55 @@
+#pragma once
+
+#include "DaisyDSP.h"
+#include "kstring.h"
+
+namespace synthux {
+
+// Drop-in for Vox built on the Karplus-Strong KString.
+// Stable over the full parameter range, so no brightness limit.
+class KSVox {
+public:
+KSVox():
+_freq_mult { 0.f }
+{}
+~KSVox() {}
+
+void Init(float sample_rate) {
+  _osc.Init(sample_rate);
+}
+
+void SetBrightness(const float value) {
+  _osc.SetBrightness(value);
+}
+
+void SetStructure(const float value) {
+  _osc.SetStructure(value);
+}
+
+void SetDamping(const float value) {
+  _osc.SetDamping(value);
+}
+
+void NoteOn(float freq, float amp) {
+  _osc.SetFreq(freq * _freq_mult);
+  _osc.Trig();
+}
+
+// Clears the string, e.g. after it blew up.
+void Reset() {
+  _osc.Reset();
+}
+
+void SetMult(const float value) {
+  _freq_mult = value;
+}
+
+float Process() { 
+    return _osc.Process();
+}
+
+private:
+  float _freq_mult;
+  KString _osc;
+};
+};
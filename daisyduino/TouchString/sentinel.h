@@ -0,0 +1,146 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+namespace synthux {
+
+/**
+ * @brief
+ * Watches one point of the signal path (voice out, filter out,
+ * delay, reverb, master) for NaN, Inf and runaway levels.
+ *
+ * Feed every sample through Watch() and call Check() once
+ * after the block is rendered. A NaN or Inf anywhere in the
+ * block poisons the running sum, so a single compare per block
+ * catches it. When Check() returns true the caller resets the
+ * module feeding this point.
+ *
+ * Sentinels register themselves in a Registry when constructed.
+ * An instrument owns its own Registry, so two instances never
+ * share a list; sketch globals use the default one. Report()
+ * from loop() prints the ones that tripped since the last report.
+ */
+class Sentinel {
+public:
+  // Default runaway limit: block RMS above +18 dBFS.
+  static constexpr float kDefaultLimit = 8.f;
+
+  class Registry {
+  public:
+    constexpr Registry(): _head { nullptr } { }
+
+    // Call from loop(). Prints only the sentinels that tripped.
+    void Report();
+
+  private:
+    friend class Sentinel;
+    Sentinel* _head;
+  };
+
+  Sentinel(Registry& registry, const char* name, const float limit = kDefaultLimit):
+  _name       { name },
+  _limit_sq   { limit * limit },
+  _energy     { 0.f },
+  _samples    { 0 },
+  _trips      { 0 },
+  _reported   { 0 },
+  _next       { registry._head }
+  {
+    registry._head = this;
+  }
+
+  Sentinel(const char* name, const float limit = kDefaultLimit):
+  Sentinel(_global, name, limit)
+  { }
+
+  inline float Watch(const float in) {
+    _energy += in * in;
+    _samples++;
+    return in;
+  }
+
+  // Returns true if the signal watched since the last call
+  // was not finite or went over the limit.
+  bool Check() {
+    // NaN fails every comparison, Inf fails this one.
+    auto is_ok = _energy <= _limit_sq * static_cast<float>(_samples);
+    _energy = 0.f;
+    _samples = 0;
+    if (is_ok) return false;
+    _trips++;
+    return true;
+  }
+
+  uint32_t Trips() const {
+    return _trips;
+  }
+
+  const char* Name() const {
+    return _name;
+  }
+
+  // Reports the sentinels in the default registry.
+  static void Report() {
+    _global.Report();
+  }
+
+private:
+  static inline Registry _global;
+
+  const char* _name;
+  float _limit_sq;
+  float _energy;
+  size_t _samples;
+  volatile uint32_t _trips;
+  uint32_t _reported;
+  Sentinel* _next;
+};
+
+inline void Sentinel::Registry::Report() {
+  for (auto s = _head; s != nullptr; s = s->_next) {
+    uint32_t trips = s->_trips;
+    if (trips == s->_reported) continue;
+    s->_reported = trips;
+    Serial.print("SENTINEL: ");
+    Serial.print(s->_name);
+    Serial.print(" reset, ");
+    Serial.print(trips);
+    Serial.println(" total");
+  }
+}
+
+/**
+ * @brief
+ * Hands a reset that's too heavy for one audio block over to
+ * loop(), e.g. ReverbSc::Init() zeroing every delay line.
+ * The callback calls Request() and leaves the module alone,
+ * muted, while IsPending(); loop() does the reset in Run().
+ */
+class DeferredReset {
+public:
+  DeferredReset():
+  _is_pending { false }
+  {}
+
+  void Request() {
+    _is_pending.store(true, std::memory_order_release);
+  }
+
+  bool IsPending() const {
+    return _is_pending.load(std::memory_order_acquire);
+  }
+
+  // Call from loop().
+  template<typename Reset>
+  void Run(Reset reset) {
+    if (!IsPending()) return;
+    reset();
+    _is_pending.store(false, std::memory_order_release);
+  }
+
+private:
+  std::atomic<bool> _is_pending;
+};
+
+};
@@ -0,0 +1,135 @@
+#pragma once
+#include <array>
+#include <math.h>
+
+#include "DaisyDSP.h"
+#include "vox.h"
+
+namespace synthux {
+
+/**
+ * @brief
+ * Parameter-space stability sweep for the string voice.
+ * Renders a fresh StringVoice over a grid of brightness,
+ * structure, damping and note frequency, flags points that go
+ * non-finite, run away or clip, tracks the worst block time,
+ * and prints a kBrightnessLimit table to paste into vox.h.
+ *
+ * Each octave bisects the brightness steps instead of walking
+ * all of them, so a run is 8 octaves x 5 probes x 27 grid
+ * points x 24000 samples, about 26M StringVoice samples.
+ * That blocks for minutes; the sweep prints its own run time.
+ * Call from setup() before DAISY.begin(), so the audio
+ * callback isn't competing for CPU.
+ */
+class StabilitySweep {
+public:
+  void Run(const float sample_rate, const size_t block_size) {
+    auto block_budget_us = 1e6f * block_size / sample_rate;
+    std::array<float, Vox::kLimitOctaves> limits;
+
+    auto sweep_start = millis();
+
+    Serial.println("SWEEP: octave, limit, lowest clipping probe, worst block us");
+    for (auto o = 0; o < Vox::kLimitOctaves; o++) {
+      auto octave_freq = Vox::kLimitBaseFreq * static_cast<float>(1 << o);
+      auto clip_from = -1.f;
+      uint32_t worst_us = 0;
+
+      // Assumes stability only gets worse with brightness:
+      // stable_step is stable, unstable_step is not.
+      int stable_step = -1;
+      int unstable_step = kBrightnessSteps + 1;
+      while (unstable_step - stable_step > 1) {
+        auto step = (stable_step + unstable_step) / 2;
+        auto brightness = static_cast<float>(step) / kBrightnessSteps;
+        auto is_stable = true;
+        for (auto f: kFreqSteps) {
+          for (auto s: kGridSteps) {
+            for (auto d: kGridSteps) {
+              auto r = _render(sample_rate, block_size, octave_freq * f, brightness, s, d);
+              worst_us = std::max(worst_us, r.worst_us);
+              if (r.peak > kClip && (clip_from < 0.f || brightness < clip_from)) clip_from = brightness;
+              if (!r.is_finite || r.peak > kRunaway) is_stable = false;
+            }
+          }
+        }
+        if (is_stable) stable_step = step;
+        else unstable_step = step;
+      }
+
+      auto limit = static_cast<float>(std::max(stable_step, 0)) / kBrightnessSteps;
+      limits[o] = limit;
+      Serial.print("SWEEP: ");
+      Serial.print(octave_freq);
+      Serial.print(" Hz, ");
+      Serial.print(limit);
+      Serial.print(", ");
+      Serial.print(clip_from);
+      Serial.print(", ");
+      Serial.print(worst_us);
+      if (worst_us > block_budget_us * kCpuBudget) Serial.print(" CPU SPIKE");
+      Serial.println();
+    }
+
+    Serial.println("static constexpr std::array<float, kLimitOctaves> kBrightnessLimit = {{");
+    Serial.print("  ");
+    for (auto o = 0; o < Vox::kLimitOctaves; o++) {
+      Serial.print(limits[o]);
+      Serial.print(o + 1 < Vox::kLimitOctaves ? "f, " : "f\n");
+    }
+    Serial.println("}};");
+
+    Serial.print("SWEEP: done in ");
+    Serial.print((millis() - sweep_start) / 1000);
+    Serial.println(" s");
+  }
+
+private:
+  struct Result {
+    bool is_finite;
+    float peak;
+    uint32_t worst_us;
+  };
+
+  Result _render(const float sample_rate,
+                 const size_t block_size,
+                 const float freq,
+                 const float brightness,
+                 const float structure,
+                 const float damping) {
+    _voice.Init(sample_rate);
+    _voice.SetBrightness(brightness);
+    // Same mapping as Vox::SetStructure
+    _voice.SetStructure(fmap(structure, 0.f, 0.8f));
+    _voice.SetDamping(damping);
+    _voice.SetFreq(freq);
+
+    Result r { true, 0.f, 0 };
+    for (size_t i = 0; i < kRenderSamples; i += block_size) {
+      // Retrigger like a fast arp would
+      if (i % kRetrigSamples < block_size) _voice.Trig();
+      auto start = micros();
+      for (size_t k = 0; k < block_size; k++) {
+        auto out = fabsf(_voice.Process());
+        if (!isfinite(out)) r.is_finite = false;
+        else if (out > r.peak) r.peak = out;
+      }
+      r.worst_us = std::max(r.worst_us, static_cast<uint32_t>(micros() - start));
+    }
+    return r;
+  }
+
+  static constexpr uint8_t kBrightnessSteps = 20;
+  static constexpr std::array<float, 3> kFreqSteps = {{ 1.f, 1.41f, 1.9f }};
+  static constexpr std::array<float, 3> kGridSteps = {{ 0.f, .5f, 1.f }};
+  static constexpr size_t kRenderSamples = 24000;
+  static constexpr size_t kRetrigSamples = 6000;
+  static constexpr float kClip = 1.f;
+  static constexpr float kRunaway = 4.f;
+  static constexpr float kCpuBudget = .5f;
+
+  StringVoice _voice;
+};
+
+};
@@ -1,4 +1,6 @@
 #pragma once
+#include <array>
+#include <math.h>
 
 #include "DaisyDSP.h"
 
@@ -6,8 +8,28 @@ namespace synthux {
 
 class Vox {
 public:
+// Highest stable StringVoice brightness per octave of the
+// played frequency, the first octave starting at kLimitBaseFreq.
+// Above it the string goes non-finite or runs away.
+// NOT MEASURED YET: every entry is the old blanket .5 clamp,
+// a placeholder until STABILITY_SWEEP in TouchString.ino has
+// been run on a Daisy and its printed table pasted in here.
+static constexpr uint8_t kLimitOctaves = 8;
+static constexpr float kLimitBaseFreq = 16.f;
+static constexpr std::array<float, kLimitOctaves> kBrightnessLimit = {{
+  .5f, .5f, .5f, .5f, .5f, .5f, .5f, .5f
+}};
+
+static float BrightnessLimit(const float freq) {
+  int octave;
+  frexpf(freq / kLimitBaseFreq, &octave);
+  return kBrightnessLimit[std::min(std::max(octave - 1, 0), kLimitOctaves - 1)];
+}
+
 Vox():
-_freq_mult { 0.f }
+_freq_mult  { 0.f },
+_brightness { 0.f },
+_limit      { kBrightnessLimit[0] }
 {}
 ~Vox() {}
 
@@ -16,9 +38,8 @@ void Init(float sample_rate) {
 }
 
 void SetBrightness(const float value) {
-  // With high brightness and pitch the osc crashes.
-  // Limiting value to 0.5 until further investigation.
-  _osc.SetBrightness(value * 0.5); 
+  _brightness = value;
+  _osc.SetBrightness(_brightness * _limit);
 }
 
 void SetStructure(const float value) {
@@ -30,10 +51,18 @@ void SetDamping(const float value) {
 }
 
 void NoteOn(float freq, float amp) {
-  _osc.SetFreq(freq * _freq_mult);
+  auto note_freq = freq * _freq_mult;
+  _limit = BrightnessLimit(note_freq);
+  _osc.SetBrightness(_brightness * _limit);
+  _osc.SetFreq(note_freq);
   _osc.Trig();
 }
 
+// Clears the string, e.g. after it blew up.
+void Reset() {
+  _osc.Reset();
+}
+
 void SetMult(const float value) {
   _freq_mult = value;
 }
@@ -44,6 +73,8 @@ float Process() {
 
 private:
   float _freq_mult;
+  float _brightness;
+  float _limit;
   StringVoice _osc;
 };
 };